@@ -4,6 +4,8 @@ rem /LIBPATH:"3rdparty/SDL2-2.0.9/lib/x64"
 set mode=debug
 rem set mode=release
 set options= 
+rem structure of arrays broadphase with sse, add /arch:AVX for the 8 wide version
+rem set options=%options% /DSIMD_COLLISION /arch:AVX
 if %mode%==debug (
 	set options=%options% /Od
 ) else (
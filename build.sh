@@ -0,0 +1,14 @@
+#!/bin/sh
+
+# linux build, needs the SDL2, SDL2_mixer and SDL2_image development packages.
+# "./wosten -headless data/levels/Level.bin" runs the simulation without display or gpu.
+mode=debug
+# mode=release
+options=
+if [ "$mode" = "debug" ]; then
+	options="$options -O0 -g"
+else
+	options="$options -O2"
+fi
+
+g++ source/sdl_wosten.cpp -o wosten $options -I "3rdparty" $(pkg-config --cflags sdl2 SDL2_mixer SDL2_image) -DSDL_MAIN_HANDLED $(pkg-config --libs sdl2 SDL2_mixer SDL2_image) -lGL
@@ -0,0 +1,185 @@
+#if !defined ALLOCATION_TRACKING_H
+#define ALLOCATION_TRACKING_H
+
+#include "defines.h"
+#include "SDL.h"
+
+// counts heap allocations inside the game loop, enabled with ALLOCATION_TRACKING.
+// operator new and the SDL allocator (SDL_malloc, also used by SDL_image and
+// SDL_mixer) are replaced, plain malloc calls of other libraries are not seen.
+// only the thread that calls ALLOCATION_TRACKING_BEGIN_FRAME is tracked, so the
+// audio thread doesn't show up.
+//
+// after the warmup frames every allocation between begin and end frame is
+// logged with its callstack (glibc only, elsewhere set Allocation_Tracking_Break
+// and look at it in the debugger).
+//
+//     ALLOCATION_TRACKING_INIT();        before SDL_Init
+//     ALLOCATION_TRACKING_BEGIN_FRAME();
+//     ... game loop ...
+//     ALLOCATION_TRACKING_END_FRAME();
+
+#if defined ALLOCATION_TRACKING
+
+#include <new>
+
+#if defined __GLIBC__
+#include <execinfo.h>
+#endif
+
+// loading, first growth of pools and the frame arena
+const u32 Allocation_Tracking_Warmup_Frames = 120;
+const u32 Allocation_Tracking_Max_Callstacks_Per_Frame = 4;
+const bool Allocation_Tracking_Break = false;
+
+struct allocation_tracker {
+    bool IsInFrame;
+    u32 FrameIndex;
+
+    u32 FrameAllocationCount;
+    usize FrameAllocationByteCount;
+
+    // after the warmup
+    u32 LoopAllocationCount;
+    u32 AllocatingFrameCount;
+
+    SDL_malloc_func  Malloc;
+    SDL_calloc_func  Calloc;
+    SDL_realloc_func Realloc;
+    SDL_free_func    Free;
+};
+
+allocation_tracker Global_Allocation_Tracker;
+thread_local bool Allocation_Tracking_Is_Tracked_Thread = false;
+thread_local bool Allocation_Tracking_Is_Reporting = false; // allocations while reporting are not counted
+
+void AllocationTrackingRecord(const char *Kind, usize Size) {
+    auto Tracker = &Global_Allocation_Tracker;
+
+    if (!Tracker->IsInFrame || !Allocation_Tracking_Is_Tracked_Thread || Allocation_Tracking_Is_Reporting)
+        return;
+
+    Tracker->FrameAllocationCount++;
+    Tracker->FrameAllocationByteCount += Size;
+
+    if (Tracker->FrameIndex < Allocation_Tracking_Warmup_Frames)
+        return;
+
+    Tracker->LoopAllocationCount++;
+
+    if (Tracker->FrameAllocationCount > Allocation_Tracking_Max_Callstacks_Per_Frame)
+        return;
+
+    Allocation_Tracking_Is_Reporting = true;
+
+    printf("allocation of %llu bytes with %s in frame %u:\n", (unsigned long long) Size, Kind, Tracker->FrameIndex);
+
+#if defined __GLIBC__
+    void *Frames[32];
+    s32 FrameCount = backtrace(Frames, ARRAY_COUNT(Frames));
+    fflush(stdout);
+    backtrace_symbols_fd(Frames, FrameCount, 1);
+#endif
+
+    if (Allocation_Tracking_Break)
+        SDL_TriggerBreakpoint();
+
+    Allocation_Tracking_Is_Reporting = false;
+}
+
+void *AllocationTrackingMalloc(size_t Size) {
+    AllocationTrackingRecord("SDL_malloc", Size);
+    return Global_Allocation_Tracker.Malloc(Size);
+}
+
+void *AllocationTrackingCalloc(size_t Count, size_t Size) {
+    AllocationTrackingRecord("SDL_calloc", Count * Size);
+    return Global_Allocation_Tracker.Calloc(Count, Size);
+}
+
+void *AllocationTrackingRealloc(void *Memory, size_t Size) {
+    AllocationTrackingRecord("SDL_realloc", Size);
+    return Global_Allocation_Tracker.Realloc(Memory, Size);
+}
+
+void AllocationTrackingFree(void *Memory) {
+    Global_Allocation_Tracker.Free(Memory);
+}
+
+void AllocationTrackingInit() {
+    auto Tracker = &Global_Allocation_Tracker;
+
+    SDL_GetMemoryFunctions(&Tracker->Malloc, &Tracker->Calloc, &Tracker->Realloc, &Tracker->Free);
+    SDL_SetMemoryFunctions(AllocationTrackingMalloc, AllocationTrackingCalloc, AllocationTrackingRealloc, AllocationTrackingFree);
+}
+
+void AllocationTrackingBeginFrame() {
+    auto Tracker = &Global_Allocation_Tracker;
+
+    Allocation_Tracking_Is_Tracked_Thread = true;
+    Tracker->IsInFrame = true;
+    Tracker->FrameAllocationCount = 0;
+    Tracker->FrameAllocationByteCount = 0;
+}
+
+void AllocationTrackingEndFrame() {
+    auto Tracker = &Global_Allocation_Tracker;
+    Tracker->IsInFrame = false;
+
+    if ((Tracker->FrameIndex >= Allocation_Tracking_Warmup_Frames) && (Tracker->FrameAllocationCount > 0)) {
+        Tracker->AllocatingFrameCount++;
+        printf("frame %u: %u allocations, %llu bytes\n", Tracker->FrameIndex, Tracker->FrameAllocationCount, (unsigned long long) Tracker->FrameAllocationByteCount);
+    }
+
+    Tracker->FrameIndex++;
+}
+
+void *operator new(size_t Size) {
+    AllocationTrackingRecord("new", Size);
+
+    void *Result = malloc(Size ? Size : 1);
+    if (Result == NULL)
+        throw std::bad_alloc();
+
+    return Result;
+}
+
+void *operator new[](size_t Size) {
+    AllocationTrackingRecord("new[]", Size);
+
+    void *Result = malloc(Size ? Size : 1);
+    if (Result == NULL)
+        throw std::bad_alloc();
+
+    return Result;
+}
+
+void operator delete(void *Memory) noexcept {
+    free(Memory);
+}
+
+void operator delete[](void *Memory) noexcept {
+    free(Memory);
+}
+
+void operator delete(void *Memory, size_t) noexcept {
+    free(Memory);
+}
+
+void operator delete[](void *Memory, size_t) noexcept {
+    free(Memory);
+}
+
+#define ALLOCATION_TRACKING_INIT()        AllocationTrackingInit()
+#define ALLOCATION_TRACKING_BEGIN_FRAME() AllocationTrackingBeginFrame()
+#define ALLOCATION_TRACKING_END_FRAME()   AllocationTrackingEndFrame()
+
+#else
+
+#define ALLOCATION_TRACKING_INIT()
+#define ALLOCATION_TRACKING_BEGIN_FRAME()
+#define ALLOCATION_TRACKING_END_FRAME()
+
+#endif // ALLOCATION_TRACKING
+
+#endif // ALLOCATION_TRACKING_H
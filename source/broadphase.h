@@ -0,0 +1,300 @@
+#if !defined BROADPHASE_H
+#define BROADPHASE_H
+
+#include "defines.h"
+
+// uniform grid stored as a spatial hash, rebuilt every frame.
+// entries are bucketed by the cell of their center, so two overlapping circles
+// are always in neighbouring cells as long as both radii are <= CellSize / 2.
+// bigger circles (bombs, powerup magnets) go into an oversized list and are
+// tested against everything.
+//
+// with SIMD_COLLISION the bucket sorted entries are stored as separate arrays
+// and one entry is tested against Simd_Width others at once.
+
+const u32 Broadphase_Bucket_Count = 4096; // must be a power of two
+const f32 Broadphase_Default_Cell_Size = 0.125f;
+
+struct broadphase_entry {
+    circle Circle;
+    u32 Index;
+    u32 Flag, Mask;
+};
+
+struct broadphase_pair {
+    u32 Indices[2];
+};
+
+#if defined SIMD_COLLISION
+
+struct broadphase_entries {
+    f32 *PosX, *PosY, *Radius;
+    u32 *Index;
+    u32 *Flag, *Mask;
+};
+
+#endif
+
+struct broadphase_grid {
+    f32 CellSize;
+
+    broadphase_entry *Entries;
+    u32 *EntryBuckets;
+    u32 EntryCount, EntryCapacity;
+
+#if defined SIMD_COLLISION
+    broadphase_entries Sorted;
+#else
+    broadphase_entry *Sorted;
+#endif
+    u32 SortedCount;
+
+    u32 *Oversized;
+    u32 OversizedCount;
+
+    u32 BucketStart[Broadphase_Bucket_Count + 1];
+
+    broadphase_pair *Pairs;
+    u32 PairCount, PairCapacity;
+};
+
+void Init(broadphase_grid *Grid, f32 CellSize = Broadphase_Default_Cell_Size) {
+    *Grid = {};
+    Grid->CellSize = CellSize;
+}
+
+void BroadphaseCell(broadphase_grid *Grid, vec2 Pos, s32 *CellX, s32 *CellY) {
+    *CellX = (s32) floorf(Pos.X / Grid->CellSize);
+    *CellY = (s32) floorf(Pos.Y / Grid->CellSize);
+}
+
+u32 BroadphaseBucket(s32 CellX, s32 CellY) {
+    u32 Hash = ((u32) CellX * 73856093u) ^ ((u32) CellY * 19349663u);
+    return Hash & (Broadphase_Bucket_Count - 1);
+}
+
+void BroadphaseBegin(broadphase_grid *Grid, u32 MaxEntryCount) {
+    if (MaxEntryCount > Grid->EntryCapacity) {
+        delete[] Grid->Entries;
+        delete[] Grid->EntryBuckets;
+        delete[] Grid->Oversized;
+
+        Grid->EntryCapacity = MAX(MaxEntryCount, Grid->EntryCapacity * 2);
+        Grid->Entries       = new broadphase_entry[Grid->EntryCapacity];
+        Grid->EntryBuckets  = new u32[Grid->EntryCapacity];
+        Grid->Oversized     = new u32[Grid->EntryCapacity];
+
+#if defined SIMD_COLLISION
+        delete[] Grid->Sorted.PosX;
+        delete[] Grid->Sorted.PosY;
+        delete[] Grid->Sorted.Radius;
+        delete[] Grid->Sorted.Index;
+        delete[] Grid->Sorted.Flag;
+        delete[] Grid->Sorted.Mask;
+
+        // padded so the last wide load never reads past the end
+        u32 PaddedCapacity = Grid->EntryCapacity + Simd_Width;
+        Grid->Sorted.PosX   = new f32[PaddedCapacity]();
+        Grid->Sorted.PosY   = new f32[PaddedCapacity]();
+        Grid->Sorted.Radius = new f32[PaddedCapacity]();
+        Grid->Sorted.Index  = new u32[Grid->EntryCapacity];
+        Grid->Sorted.Flag   = new u32[Grid->EntryCapacity];
+        Grid->Sorted.Mask   = new u32[Grid->EntryCapacity];
+#else
+        delete[] Grid->Sorted;
+        Grid->Sorted = new broadphase_entry[Grid->EntryCapacity];
+#endif
+    }
+
+    Grid->EntryCount = 0;
+    Grid->SortedCount = 0;
+    Grid->OversizedCount = 0;
+    Grid->PairCount = 0;
+}
+
+// Flag is the FLAG() of the entries type, Mask the types it wants to collide with
+void BroadphaseAdd(broadphase_grid *Grid, u32 Index, circle Circle, u32 Flag, u32 Mask) {
+    assert(Grid->EntryCount < Grid->EntryCapacity);
+
+    u32 EntryIndex = Grid->EntryCount++;
+    Grid->Entries[EntryIndex] = { Circle, Index, Flag, Mask };
+
+    if (Circle.Radius * 2 > Grid->CellSize) {
+        Grid->Oversized[Grid->OversizedCount++] = EntryIndex;
+        Grid->EntryBuckets[EntryIndex] = Broadphase_Bucket_Count;
+    }
+    else {
+        s32 CellX, CellY;
+        BroadphaseCell(Grid, Circle.Pos, &CellX, &CellY);
+        Grid->EntryBuckets[EntryIndex] = BroadphaseBucket(CellX, CellY);
+    }
+}
+
+void BroadphasePushPair(broadphase_grid *Grid, u32 A, u32 B) {
+    if (Grid->PairCount == Grid->PairCapacity) {
+        u32 NewCapacity = MAX(256, Grid->PairCapacity * 2);
+        auto NewPairs = new broadphase_pair[NewCapacity];
+        memcpy(NewPairs, Grid->Pairs, sizeof(broadphase_pair) * Grid->PairCount);
+        delete[] Grid->Pairs;
+
+        Grid->Pairs = NewPairs;
+        Grid->PairCapacity = NewCapacity;
+    }
+
+    Grid->Pairs[Grid->PairCount++] = { A, B };
+}
+
+bool BroadphaseCanCollide(u32 FlagA, u32 MaskA, u32 FlagB, u32 MaskB) {
+    return ((MaskA & FlagB) && (MaskB & FlagA));
+}
+
+void BroadphaseSetSorted(broadphase_grid *Grid, u32 SortedIndex, broadphase_entry *Entry) {
+#if defined SIMD_COLLISION
+    Grid->Sorted.PosX[SortedIndex]   = Entry->Circle.Pos.X;
+    Grid->Sorted.PosY[SortedIndex]   = Entry->Circle.Pos.Y;
+    Grid->Sorted.Radius[SortedIndex] = Entry->Circle.Radius;
+    Grid->Sorted.Index[SortedIndex]  = Entry->Index;
+    Grid->Sorted.Flag[SortedIndex]   = Entry->Flag;
+    Grid->Sorted.Mask[SortedIndex]   = Entry->Mask;
+#else
+    Grid->Sorted[SortedIndex] = *Entry;
+#endif
+}
+
+broadphase_entry BroadphaseGetSorted(broadphase_grid *Grid, u32 SortedIndex) {
+#if defined SIMD_COLLISION
+    broadphase_entry Result;
+    Result.Circle = { { Grid->Sorted.PosX[SortedIndex], Grid->Sorted.PosY[SortedIndex] }, Grid->Sorted.Radius[SortedIndex] };
+    Result.Index  = Grid->Sorted.Index[SortedIndex];
+    Result.Flag   = Grid->Sorted.Flag[SortedIndex];
+    Result.Mask   = Grid->Sorted.Mask[SortedIndex];
+
+    return Result;
+#else
+    return Grid->Sorted[SortedIndex];
+#endif
+}
+
+// pushes a pair for every sorted entry in [Start, End) that overlaps Entry and wants to collide with it
+void BroadphaseTestRange(broadphase_grid *Grid, broadphase_entry *Entry, u32 Start, u32 End) {
+#if defined SIMD_COLLISION
+    auto Sorted = &Grid->Sorted;
+
+    for (u32 j = Start; j < End; j += Simd_Width) {
+        u32 Hits = areIntersectingWide(Entry->Circle, Sorted->PosX + j, Sorted->PosY + j, Sorted->Radius + j);
+
+        if (End - j < Simd_Width)
+            Hits &= (1u << (End - j)) - 1;
+
+        for (u32 Lane = 0; Hits; Lane++, Hits >>= 1) {
+            if (!(Hits & 1))
+                continue;
+
+            u32 k = j + Lane;
+            if (BroadphaseCanCollide(Entry->Flag, Entry->Mask, Sorted->Flag[k], Sorted->Mask[k]))
+                BroadphasePushPair(Grid, Entry->Index, Sorted->Index[k]);
+        }
+    }
+#else
+    for (u32 j = Start; j < End; j++) {
+        auto Other = Grid->Sorted + j;
+
+        if (!BroadphaseCanCollide(Entry->Flag, Entry->Mask, Other->Flag, Other->Mask))
+            continue;
+
+        if (areIntersecting(Entry->Circle, Other->Circle))
+            BroadphasePushPair(Grid, Entry->Index, Other->Index);
+    }
+#endif
+}
+
+// sorts the entries into their buckets and collects all intersecting pairs
+// into Grid->Pairs. pairs contain the Index passed to BroadphaseAdd.
+void BroadphaseEnd(broadphase_grid *Grid) {
+
+    // counting sort by bucket
+    for (u32 i = 0; i <= Broadphase_Bucket_Count; i++) {
+        Grid->BucketStart[i] = 0;
+    }
+
+    for (u32 i = 0; i < Grid->EntryCount; i++) {
+        if (Grid->EntryBuckets[i] < Broadphase_Bucket_Count)
+            Grid->BucketStart[Grid->EntryBuckets[i] + 1]++;
+    }
+
+    for (u32 i = 0; i < Broadphase_Bucket_Count; i++) {
+        Grid->BucketStart[i + 1] += Grid->BucketStart[i];
+    }
+
+    Grid->SortedCount = Grid->BucketStart[Broadphase_Bucket_Count];
+
+    // BucketStart[Bucket] is used as write cursor and ends up at the start of the next bucket,
+    // so we shift it back afterwards
+    for (u32 i = 0; i < Grid->EntryCount; i++) {
+        u32 Bucket = Grid->EntryBuckets[i];
+        if (Bucket < Broadphase_Bucket_Count)
+            BroadphaseSetSorted(Grid, Grid->BucketStart[Bucket]++, Grid->Entries + i);
+    }
+
+    for (u32 i = Broadphase_Bucket_Count; i > 0; i--) {
+        Grid->BucketStart[i] = Grid->BucketStart[i - 1];
+    }
+    Grid->BucketStart[0] = 0;
+
+    assert(Grid->BucketStart[Broadphase_Bucket_Count] == Grid->SortedCount);
+
+    // each pair is only reported by the entry with the lower sorted index
+    for (u32 i = 0; i < Grid->SortedCount; i++) {
+        auto Entry = BroadphaseGetSorted(Grid, i);
+
+        s32 CellX, CellY;
+        BroadphaseCell(Grid, Entry.Circle.Pos, &CellX, &CellY);
+
+        u32 VisitedBuckets[9];
+        u32 VisitedCount = 0;
+
+        for (s32 OffsetY = -1; OffsetY <= 1; OffsetY++) {
+            for (s32 OffsetX = -1; OffsetX <= 1; OffsetX++) {
+                u32 Bucket = BroadphaseBucket(CellX + OffsetX, CellY + OffsetY);
+
+                // different cells can hash into the same bucket
+                bool WasVisited = false;
+                for (u32 v = 0; v < VisitedCount; v++) {
+                    if (VisitedBuckets[v] == Bucket) {
+                        WasVisited = true;
+                        break;
+                    }
+                }
+
+                if (WasVisited)
+                    continue;
+
+                VisitedBuckets[VisitedCount++] = Bucket;
+
+                u32 Start = MAX(Grid->BucketStart[Bucket], i + 1);
+                u32 End   = Grid->BucketStart[Bucket + 1];
+
+                BroadphaseTestRange(Grid, &Entry, Start, End);
+            }
+        }
+    }
+
+    // oversized entries against everything
+    for (u32 i = 0; i < Grid->OversizedCount; i++) {
+        auto Entry = Grid->Entries + Grid->Oversized[i];
+
+        BroadphaseTestRange(Grid, Entry, 0, Grid->SortedCount);
+
+        for (u32 j = i + 1; j < Grid->OversizedCount; j++) {
+            auto Other = Grid->Entries + Grid->Oversized[j];
+
+            if (!BroadphaseCanCollide(Entry->Flag, Entry->Mask, Other->Flag, Other->Mask))
+                continue;
+
+            if (areIntersecting(Entry->Circle, Other->Circle))
+                BroadphasePushPair(Grid, Entry->Index, Other->Index);
+        }
+    }
+}
+
+#endif // BROADPHASE_H
@@ -6,6 +6,7 @@
 #include <cfloat> 
 
 #define  u8 uint8_t
+#define u16 uint16_t
 #define u32 uint32_t
 #define u64 uint64_t
 
@@ -15,6 +16,7 @@
 #define usize size_t
 
 #define f32 float
+#define f64 double
 
 #define f32_min -FLT_MAX
 #define f32_max  FLT_MAX
@@ -237,5 +239,70 @@ bool areIntersecting(circle A, circle B) {
     return (CombinedRadius * CombinedRadius >= lengthSquared(Distance));
 }
 
+// A and B are at their end positions and moved by MotionA and MotionB in the same time,
+// true if they touched anywhere on the way. with no motion this is areIntersecting
+bool areIntersectingSwept(circle A, vec2 MotionA, circle B, vec2 MotionB) {
+    f32 CombinedRadius = A.Radius + B.Radius;
+    
+    // B stays at the origin, A moves from Start to Start + Motion
+    vec2 Motion = MotionA - MotionB;
+    vec2 Start = (A.Pos - MotionA) - (B.Pos - MotionB);
+    
+    f32 MotionLengthSquared = lengthSquared(Motion);
+    f32 T = 1.0f;
+    
+    if (MotionLengthSquared > 0.0f)
+        T = CLAMP(-dot(Start, Motion) / MotionLengthSquared, 0.0f, 1.0f);
+    
+    vec2 Closest = Start + Motion * T;
+    
+    return (CombinedRadius * CombinedRadius >= lengthSquared(Closest));
+}
+
+// circle around everything A touched while moving by Motion
+circle sweptBounds(circle A, vec2 Motion) {
+    circle Result;
+    Result.Pos = A.Pos - Motion * 0.5f;
+    Result.Radius = A.Radius + length(Motion) * 0.5f;
+    
+    return Result;
+}
+
+#if defined SIMD_COLLISION
+
+#include <immintrin.h>
+
+#if defined __AVX__
+const u32 Simd_Width = 8;
+#else
+const u32 Simd_Width = 4;
+#endif
+
+// tests A against the next Simd_Width circles stored as separate arrays,
+// returns one bit per intersecting circle
+u32 areIntersectingWide(circle A, f32 *BX, f32 *BY, f32 *BRadius) {
+#if defined __AVX__
+    __m256 DX = _mm256_sub_ps(_mm256_set1_ps(A.Pos.X), _mm256_loadu_ps(BX));
+    __m256 DY = _mm256_sub_ps(_mm256_set1_ps(A.Pos.Y), _mm256_loadu_ps(BY));
+    __m256 CombinedRadius = _mm256_add_ps(_mm256_set1_ps(A.Radius), _mm256_loadu_ps(BRadius));
+    
+    __m256 DistanceSquared = _mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY));
+    __m256 IsIntersecting = _mm256_cmp_ps(DistanceSquared, _mm256_mul_ps(CombinedRadius, CombinedRadius), _CMP_LE_OQ);
+    
+    return _mm256_movemask_ps(IsIntersecting);
+#else
+    __m128 DX = _mm_sub_ps(_mm_set1_ps(A.Pos.X), _mm_loadu_ps(BX));
+    __m128 DY = _mm_sub_ps(_mm_set1_ps(A.Pos.Y), _mm_loadu_ps(BY));
+    __m128 CombinedRadius = _mm_add_ps(_mm_set1_ps(A.Radius), _mm_loadu_ps(BRadius));
+    
+    __m128 DistanceSquared = _mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY));
+    __m128 IsIntersecting = _mm_cmple_ps(DistanceSquared, _mm_mul_ps(CombinedRadius, CombinedRadius));
+    
+    return _mm_movemask_ps(IsIntersecting);
+#endif
+}
+
+#endif // SIMD_COLLISION
+
 
 #endif // DEFINES_H
\ No newline at end of file
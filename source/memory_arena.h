@@ -0,0 +1,147 @@
+#if !defined MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include "defines.h"
+
+// linear allocator, pushing is a pointer bump and everything is freed at once
+// with ResetArena. when a block runs full a new one is chained, so there is no
+// fixed capacity. ResetArena replaces the chain with one block that fits the
+// high water mark, so after the first few frames nothing touches the heap.
+//
+//     auto Temporary = BeginTemporaryMemory(Arena);
+//     auto Scratch = PUSH_ARRAY(Arena, u8, Size);
+//     EndTemporaryMemory(Temporary); // frees everything pushed since begin
+
+const usize Memory_Arena_Default_Block_Size = 1 << 20;
+
+struct memory_arena_block {
+    u8 *Base;
+    usize Size, Used;
+    memory_arena_block *Previous;
+};
+
+struct memory_arena {
+    memory_arena_block *Current;
+    usize MinimumBlockSize; // Memory_Arena_Default_Block_Size if 0
+
+    // bytes pushed including alignment
+    usize Used;
+    usize LastUsed;      // Used before the last ResetArena
+    usize HighWaterMark; // most Used ever
+    u32 OverflowCount;   // pushes that didn't fit the current block, ResetArena keeps this from growing
+
+    u32 TemporaryCount;
+};
+
+struct temporary_memory {
+    memory_arena *Arena;
+    memory_arena_block *Block;
+    usize BlockUsed, Used;
+};
+
+// everything that only lives for one frame, reset at the end of the frame
+memory_arena Global_Frame_Arena;
+
+void PushArenaBlock(memory_arena *Arena, usize Size) {
+    auto Block = new memory_arena_block();
+    Block->Base = new u8[Size];
+    Block->Size = Size;
+    Block->Previous = Arena->Current;
+
+    Arena->Current = Block;
+}
+
+void PopArenaBlock(memory_arena *Arena) {
+    auto Block = Arena->Current;
+    Arena->Current = Block->Previous;
+
+    delete[] Block->Base;
+    delete Block;
+}
+
+usize AlignmentPadding(memory_arena_block *Block, usize Alignment) {
+    usize Address = (usize) (Block->Base + Block->Used);
+    return (Alignment - (Address & (Alignment - 1))) & (Alignment - 1);
+}
+
+// the memory is not cleared
+u8 *PushSize(memory_arena *Arena, usize Size, usize Alignment = 16) {
+    assert((Alignment & (Alignment - 1)) == 0);
+
+    usize Padding = 0;
+    if (Arena->Current)
+        Padding = AlignmentPadding(Arena->Current, Alignment);
+
+    if (!Arena->Current || (Arena->Current->Used + Padding + Size > Arena->Current->Size)) {
+        if (Arena->Current)
+            Arena->OverflowCount++;
+
+        usize MinimumBlockSize = Arena->MinimumBlockSize ? Arena->MinimumBlockSize : Memory_Arena_Default_Block_Size;
+        PushArenaBlock(Arena, MAX(Size + Alignment, MinimumBlockSize));
+
+        Padding = AlignmentPadding(Arena->Current, Alignment);
+    }
+
+    auto Block = Arena->Current;
+    u8 *Result = Block->Base + Block->Used + Padding;
+
+    Block->Used += Padding + Size;
+    Arena->Used += Padding + Size;
+    Arena->HighWaterMark = MAX(Arena->HighWaterMark, Arena->Used);
+
+    return Result;
+}
+
+#define PUSH_ARRAY(Arena, type, Count) ((type *) PushSize(Arena, sizeof(type) * (Count), alignof(type)))
+#define PUSH_STRUCT(Arena, type) PUSH_ARRAY(Arena, type, 1)
+
+temporary_memory BeginTemporaryMemory(memory_arena *Arena) {
+    temporary_memory Result;
+    Result.Arena = Arena;
+    Result.Block = Arena->Current;
+    Result.BlockUsed = Arena->Current ? Arena->Current->Used : 0;
+    Result.Used = Arena->Used;
+
+    Arena->TemporaryCount++;
+
+    return Result;
+}
+
+void EndTemporaryMemory(temporary_memory Temporary) {
+    auto Arena = Temporary.Arena;
+    assert(Arena->TemporaryCount > 0);
+
+    // blocks chained since begin, ResetArena makes sure this stays rare.
+    // the first block is kept, so an empty arena doesn't allocate every time
+    while ((Arena->Current != Temporary.Block) && (Temporary.Block || Arena->Current->Previous))
+        PopArenaBlock(Arena);
+
+    if (Arena->Current)
+        Arena->Current->Used = Temporary.BlockUsed;
+
+    Arena->Used = Temporary.Used;
+    Arena->TemporaryCount--;
+}
+
+void ResetArena(memory_arena *Arena) {
+    assert(Arena->TemporaryCount == 0);
+
+    Arena->LastUsed = Arena->Used;
+    Arena->Used = 0;
+
+    if (!Arena->Current)
+        return;
+
+    // one block with some room to spare instead of a chain
+    if (Arena->Current->Previous || (Arena->Current->Size < Arena->HighWaterMark)) {
+        while (Arena->Current)
+            PopArenaBlock(Arena);
+
+        usize MinimumBlockSize = Arena->MinimumBlockSize ? Arena->MinimumBlockSize : Memory_Arena_Default_Block_Size;
+        PushArenaBlock(Arena, MAX(Arena->HighWaterMark + Arena->HighWaterMark / 2, MinimumBlockSize));
+    }
+
+    Arena->Current->Used = 0;
+}
+
+#endif // MEMORY_ARENA_H
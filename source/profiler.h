@@ -0,0 +1,153 @@
+#if !defined PROFILER_H
+#define PROFILER_H
+
+#include "defines.h"
+#include "SDL.h"
+
+// hierarchical scope timing, enabled with PROFILER.
+// every thread writes finished scopes into its own ring buffer, so recording
+// needs no locks. ProfileWriteChromeTrace dumps the buffers as chrome
+// trace_event json (open with chrome://tracing or ui.perfetto.dev).
+//
+//     PROFILE_FUNCTION();          times the rest of the function
+//     PROFILE_SCOPE("name");       times the rest of the scope
+//     PROFILE_BEGIN("name"); ... PROFILE_END();
+
+#if defined PROFILER
+
+const u32 Profile_Event_Count = 1 << 16; // per thread, must be a power of two
+const u32 Profile_Max_Depth   = 64;
+
+struct profile_event {
+    const char *Name;
+    u64 StartTicks, EndTicks;
+    u32 Depth;
+};
+
+struct profile_open_scope {
+    const char *Name;
+    u64 StartTicks;
+};
+
+struct profile_thread {
+    profile_event *Events;
+    SDL_atomic_t WriteCount; // only the owning thread increments it
+
+    profile_open_scope OpenScopes[Profile_Max_Depth];
+    u32 Depth;
+
+    u32 ThreadId;
+    profile_thread *Next;
+};
+
+// all threads that ever recorded something, pushed lock free
+profile_thread *Profile_Threads = NULL;
+thread_local profile_thread *Profile_Current_Thread = NULL;
+
+profile_thread *ProfileGetThread() {
+    if (Profile_Current_Thread)
+        return Profile_Current_Thread;
+
+    auto Thread = new profile_thread();
+    Thread->Events = new profile_event[Profile_Event_Count];
+    Thread->ThreadId = (u32) SDL_ThreadID();
+
+    do {
+        Thread->Next = Profile_Threads;
+    } while (!SDL_AtomicCASPtr((void **) &Profile_Threads, Thread->Next, Thread));
+
+    Profile_Current_Thread = Thread;
+    return Thread;
+}
+
+void ProfileBegin(const char *Name) {
+    auto Thread = ProfileGetThread();
+    assert(Thread->Depth < Profile_Max_Depth);
+
+    Thread->OpenScopes[Thread->Depth++] = { Name, SDL_GetPerformanceCounter() };
+}
+
+void ProfileEnd() {
+    u64 EndTicks = SDL_GetPerformanceCounter();
+
+    auto Thread = ProfileGetThread();
+    assert(Thread->Depth > 0);
+
+    auto Scope = Thread->OpenScopes + (--Thread->Depth);
+    u32 Index = (u32) SDL_AtomicGet(&Thread->WriteCount) & (Profile_Event_Count - 1);
+    Thread->Events[Index] = { Scope->Name, Scope->StartTicks, EndTicks, Thread->Depth };
+
+    // publish after the event is written
+    SDL_AtomicAdd(&Thread->WriteCount, 1);
+}
+
+struct profile_scope {
+    profile_scope(const char *Name) {
+        ProfileBegin(Name);
+    }
+
+    ~profile_scope() {
+        ProfileEnd();
+    }
+};
+
+// writes the last Profile_Event_Count scopes of every thread.
+// scopes recorded while writing may be torn, so dump between frames.
+bool ProfileWriteChromeTrace(const char *FileName) {
+    SDL_RWops *File = SDL_RWFromFile(FileName, "wb");
+    if (!File) {
+        printf("could not open %s for the profile trace\n", FileName);
+        return false;
+    }
+
+    f64 TicksToMicroseconds = 1000000.0 / SDL_GetPerformanceFrequency();
+    bool IsFirst = true;
+    u32 WrittenCount = 0;
+
+    char Buffer[512];
+    s32 ByteCount = snprintf(ARRAY_WITH_COUNT(Buffer), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    SDL_RWwrite(File, Buffer, ByteCount, 1);
+
+    for (auto Thread = (profile_thread *) SDL_AtomicGetPtr((void **) &Profile_Threads); Thread; Thread = Thread->Next) {
+        u32 WriteCount = (u32) SDL_AtomicGet(&Thread->WriteCount);
+        u32 Count = MIN(WriteCount, Profile_Event_Count);
+
+        for (u32 i = WriteCount - Count; i != WriteCount; i++) {
+            auto Event = Thread->Events + (i & (Profile_Event_Count - 1));
+
+            ByteCount = snprintf(ARRAY_WITH_COUNT(Buffer), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}",
+                                 IsFirst ? "" : ",\n", Event->Name, Thread->ThreadId,
+                                 Event->StartTicks * TicksToMicroseconds, (Event->EndTicks - Event->StartTicks) * TicksToMicroseconds, Event->Depth);
+            SDL_RWwrite(File, Buffer, ByteCount, 1);
+
+            IsFirst = false;
+            WrittenCount++;
+        }
+    }
+
+    ByteCount = snprintf(ARRAY_WITH_COUNT(Buffer), "\n]}\n");
+    SDL_RWwrite(File, Buffer, ByteCount, 1);
+    SDL_RWclose(File);
+
+    printf("wrote %u profile scopes to %s\n", WrittenCount, FileName);
+    return true;
+}
+
+#define PROFILE_CONCAT_(A, B) A ## B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_(A, B)
+
+#define PROFILE_SCOPE(Name) profile_scope PROFILE_CONCAT(ProfileScope, __LINE__)(Name)
+#define PROFILE_FUNCTION()  PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_BEGIN(Name) ProfileBegin(Name)
+#define PROFILE_END()       ProfileEnd()
+
+#else
+
+#define PROFILE_SCOPE(Name)
+#define PROFILE_FUNCTION()
+#define PROFILE_BEGIN(Name)
+#define PROFILE_END()
+
+#endif // PROFILER
+
+#endif // PROFILER_H
@@ -0,0 +1,47 @@
+#if !defined RANDOM_H
+#define RANDOM_H
+
+#include "defines.h"
+
+// pcg32 (www.pcg-random.org). every system that needs random numbers owns its own
+// series, so the same seed always gives the same numbers no matter what else is
+// drawing random numbers in between.
+
+struct random_series {
+    u64 State;
+    u64 Increment;
+};
+
+u32 RandomNext(random_series *Series) {
+    u64 OldState = Series->State;
+    Series->State = OldState * 6364136223846793005ull + Series->Increment;
+    
+    u32 XorShifted = (u32) (((OldState >> 18) ^ OldState) >> 27);
+    u32 Rotation = (u32) (OldState >> 59);
+    
+    return (XorShifted >> Rotation) | (XorShifted << ((0 - Rotation) & 31));
+}
+
+// different Streams with the same Seed give unrelated sequences
+random_series MakeRandomSeries(u64 Seed, u64 Stream) {
+    random_series Result;
+    Result.State = 0;
+    Result.Increment = (Stream << 1) | 1;
+    
+    RandomNext(&Result);
+    Result.State += Seed;
+    RandomNext(&Result);
+    
+    return Result;
+}
+
+// [0, 1)
+f32 randZeroToOne(random_series *Series){
+    return (RandomNext(Series) >> 8) * (1.0f / (1 << 24));
+}
+
+f32 randMinusOneToOne(random_series *Series){
+    return (randZeroToOne(Series) * 2 - 1.0f);
+}
+
+#endif // RANDOM_H
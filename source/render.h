@@ -2,8 +2,11 @@
 #define RENDER_H
 
 #include "defines.h"
+#include "profiler.h"
+#include "memory_arena.h"
 #include "SDL_opengl.h"
 #include <stdarg.h>
+#include <stddef.h>
 
 enum Text_Align
 {
@@ -62,11 +65,24 @@ vec2 CanvasToWorldPoint(camera Camera, vec2 CanvasPoint){
     return CanvasPoint;
 }
 
+// textures packed into an atlas share their Object and only cover [UVMin, UVMax] of it,
+// Width and Height are always the size of the image itself
 struct texture {
     s32 Width, Height;
     GLuint Object;
+    vec2 UVMin, UVMax;
 };
 
+// X and Y in texels of the image, returns the uv inside of Texture.Object
+vec2 TextureUV(texture Texture, f32 X, f32 Y) {
+    vec2 Result = {
+        lerp(Texture.UVMin.X, Texture.UVMax.X, X / Texture.Width),
+        lerp(Texture.UVMin.Y, Texture.UVMax.Y, Y / Texture.Height),
+    };
+    
+    return Result;
+}
+
 struct glyph {
     u32 Code;
     s32 DrawXAdvance;
@@ -104,36 +120,265 @@ void DrawQuad(camera Camera, transform XForm, vec2 Center = {0.5f, 0.5f}){
 
 const f32 Default_World_Units_Per_Texel = 0.01f;
 
+// sprite batch
+// quads are collected with PushSprite and drawn on FlushSprites.
+// the flush sorts them by blend mode and texture (keeping the push order
+// inside of each group), uploads all vertices into one streaming vbo and
+// issues one draw call per group.
+
+// buffer objects are not part of the gl 1.1 headers on windows
+PFNGLGENBUFFERSPROC    glGenBuffers    = NULL;
+PFNGLBINDBUFFERPROC    glBindBuffer    = NULL;
+PFNGLBUFFERDATAPROC    glBufferData    = NULL;
+PFNGLBUFFERSUBDATAPROC glBufferSubData = NULL;
+
+enum sprite_blend_mode {
+    Sprite_Blend_Alpha,
+    Sprite_Blend_Additive,
+    Sprite_Blend_Opaque,
+};
+
+struct sprite_vertex {
+    f32 X, Y, Z;
+    f32 U, V;
+    u32 Color; // RGBA8
+};
+
+struct sprite_quad {
+    sprite_vertex Vertices[4];
+};
+
+struct sprite_batch {
+    GLuint VertexBuffer;
+    u32 VertexBufferQuadCapacity; // what batched flushes orphan the vertex buffer with
+    
+    sprite_quad *Quads;
+    u64 *SortKeys; // blend mode | texture | push index
+    sprite_quad *SortedQuads;
+    u32 QuadCount, QuadCapacity;
+    
+    // while false every pushed sprite is flushed right away
+    bool IsBatching;
+    
+    // since the last ResetSpriteStats
+    struct {
+        u32 QuadCount;
+        u32 DrawCallCount;
+        u32 FlushCount;
+    } Stats;
+};
+
+sprite_batch Global_Sprite_Batch;
+
+void Init(sprite_batch *Batch) {
+    *Batch = {};
+    
+    glGenBuffers    = (PFNGLGENBUFFERSPROC)    SDL_GL_GetProcAddress("glGenBuffers");
+    glBindBuffer    = (PFNGLBINDBUFFERPROC)    SDL_GL_GetProcAddress("glBindBuffer");
+    glBufferData    = (PFNGLBUFFERDATAPROC)    SDL_GL_GetProcAddress("glBufferData");
+    glBufferSubData = (PFNGLBUFFERSUBDATAPROC) SDL_GL_GetProcAddress("glBufferSubData");
+    assert(glGenBuffers && glBindBuffer && glBufferData && glBufferSubData);
+    
+    glGenBuffers(1, &Batch->VertexBuffer);
+}
+
+void ResetSpriteStats(sprite_batch *Batch) {
+    Batch->Stats = {};
+}
+
+u32 PackColor(color Color) {
+    u32 R = (u32) (CLAMP(Color.R, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 G = (u32) (CLAMP(Color.G, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 B = (u32) (CLAMP(Color.B, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 A = (u32) (CLAMP(Color.A, 0.0f, 1.0f) * 255.0f + 0.5f);
+    
+    // byte order in memory is R, G, B, A on little endian
+    return R | (G << 8) | (B << 16) | (A << 24);
+}
+
+int CompareSpriteSortKeys(const void *A, const void *B) {
+    u64 KeyA = *(u64 *) A;
+    u64 KeyB = *(u64 *) B;
+    
+    return (KeyA > KeyB) - (KeyA < KeyB);
+}
+
+void SetSpriteBlendMode(sprite_blend_mode BlendMode) {
+    switch (BlendMode) {
+        case Sprite_Blend_Alpha: {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        } break;
+        
+        case Sprite_Blend_Additive: {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        } break;
+        
+        case Sprite_Blend_Opaque: {
+            glDisable(GL_BLEND);
+        } break;
+    }
+}
+
+void FlushSprites(sprite_batch *Batch) {
+    if (Batch->QuadCount == 0)
+        return;
+    
+    PROFILE_FUNCTION();
+    
+    qsort(Batch->SortKeys, Batch->QuadCount, sizeof(u64), CompareSpriteSortKeys);
+    
+    for (u32 i = 0; i < Batch->QuadCount; i++) {
+        Batch->SortedQuads[i] = Batch->Quads[(u32) Batch->SortKeys[i]];
+    }
+    
+    glBindBuffer(GL_ARRAY_BUFFER, Batch->VertexBuffer);
+    
+    // orphan the old storage so we don't wait on draws still using it.
+    // batches always ask for the same size, so the driver can hand back a recycled buffer,
+    // sprites drawn outside of BeginSprites are flushed one by one and only need their own quad
+    u32 OrphanQuadCount = Batch->QuadCount;
+    if (Batch->IsBatching) {
+        if (Batch->QuadCount > Batch->VertexBufferQuadCapacity)
+            Batch->VertexBufferQuadCapacity = Batch->QuadCapacity;
+        
+        OrphanQuadCount = Batch->VertexBufferQuadCapacity;
+    }
+    
+    glBufferData(GL_ARRAY_BUFFER, sizeof(sprite_quad) * OrphanQuadCount, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sprite_quad) * Batch->QuadCount, Batch->SortedQuads);
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    
+    glVertexPointer(3, GL_FLOAT, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, X));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, U));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, Color));
+    
+    GLboolean WasBlendEnabled = glIsEnabled(GL_BLEND);
+    GLboolean WasTextureEnabled = glIsEnabled(GL_TEXTURE_2D);
+    glEnable(GL_TEXTURE_2D);
+    
+    u32 Start = 0;
+    while (Start < Batch->QuadCount) {
+        u64 Group = Batch->SortKeys[Start] >> 32;
+        
+        u32 End = Start + 1;
+        while ((End < Batch->QuadCount) && ((Batch->SortKeys[End] >> 32) == Group))
+            End++;
+        
+        SetSpriteBlendMode((sprite_blend_mode) (Group >> 24));
+        glBindTexture(GL_TEXTURE_2D, (GLuint) (Group & 0xFFFFFF));
+        glDrawArrays(GL_QUADS, Start * 4, (End - Start) * 4);
+        
+        Batch->Stats.DrawCallCount++;
+        Start = End;
+    }
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    if (WasBlendEnabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+    
+    // Sprite_Blend_Alpha is what everyone else expects
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    if (!WasTextureEnabled)
+        glDisable(GL_TEXTURE_2D);
+    
+    Batch->Stats.QuadCount += Batch->QuadCount;
+    Batch->Stats.FlushCount++;
+    Batch->QuadCount = 0;
+}
+
+void BeginSprites(sprite_batch *Batch) {
+    assert(!Batch->IsBatching);
+    Batch->IsBatching = true;
+}
+
+void EndSprites(sprite_batch *Batch) {
+    assert(Batch->IsBatching);
+    FlushSprites(Batch);
+    Batch->IsBatching = false;
+}
+
+// Corners are canvas points in counter clockwise order starting at the texture origin
+void PushSprite(sprite_batch *Batch, GLuint Texture, vec2 Corners[4], vec2 UVMin, vec2 UVMax, color Color, f32 Z = 0, sprite_blend_mode BlendMode = Sprite_Blend_Alpha) {
+    assert(Texture <= 0xFFFFFF);
+    
+    if (Batch->QuadCount == Batch->QuadCapacity) {
+        u32 NewCapacity = MAX(1024, Batch->QuadCapacity * 2);
+        
+        auto NewQuads = new sprite_quad[NewCapacity];
+        memcpy(NewQuads, Batch->Quads, sizeof(sprite_quad) * Batch->QuadCount);
+        
+        auto NewSortKeys = new u64[NewCapacity];
+        memcpy(NewSortKeys, Batch->SortKeys, sizeof(u64) * Batch->QuadCount);
+        
+        delete[] Batch->Quads;
+        delete[] Batch->SortKeys;
+        delete[] Batch->SortedQuads;
+        
+        Batch->Quads = NewQuads;
+        Batch->SortKeys = NewSortKeys;
+        Batch->SortedQuads = new sprite_quad[NewCapacity];
+        Batch->QuadCapacity = NewCapacity;
+    }
+    
+    u32 Index = Batch->QuadCount++;
+    auto Quad = Batch->Quads + Index;
+    
+    u32 PackedColor = PackColor(Color);
+    vec2 UVs[4] = { UVMin, { UVMax.X, UVMin.Y }, UVMax, { UVMin.X, UVMax.Y } };
+    
+    for (u32 i = 0; i < 4; i++) {
+        Quad->Vertices[i] = { Corners[i].X, Corners[i].Y, Z, UVs[i].X, UVs[i].Y, PackedColor };
+    }
+    
+    Batch->SortKeys[Index] = ((u64) BlendMode << 56) | ((u64) Texture << 32) | Index;
+    
+    if (!Batch->IsBatching)
+        FlushSprites(Batch);
+}
+
 void DrawTexturedQuad(camera Camera, transform XForm, texture FillTexture, color FillColor = White_Color, vec2 RelativeCenter = {0.5f, 0.5f}, f32 TexelScale = Default_World_Units_Per_Texel, f32 Z = 0, f32 DoFlip = 0.0f){
     
-    //vec2 texelSize = vec2{1.0f / FillTexture.Width, 1.0f / FillTexture.Height};
     vec2 QuadSize = vec2{(f32) FillTexture.Width, (f32) FillTexture.Height} * TexelScale;
     vec2 Center = QuadSize * RelativeCenter;
     
+    // same as TransformPoint, but only one cos and sin per quad
+    f32 CosRotation = cos(XForm.Rotation) * XForm.Scale;
+    f32 SinRotation = sin(XForm.Rotation) * XForm.Scale;
     
-    glBindTexture(GL_TEXTURE_2D, FillTexture.Object);
-    
-    glBegin(GL_QUADS);
-    glColor4fv(FillColor.Values);
-    //assuming our textures are flipped        
+    vec2 Corners[4] = {
+        vec2{0, 0} - Center,
+        vec2{QuadSize.X, 0} - Center,
+        QuadSize - Center,
+        vec2{0, QuadSize.Y} - Center,
+    };
     
-    glTexCoord2f(0, lerp(0, 1, DoFlip));  	
-    vec2 V = WorldToCanvasPoint(Camera, TransformPoint(XForm, vec2{0, 0} - Center));
-    glVertex3f(V.X, V.Y, Z);    
+    for (u32 i = 0; i < 4; i++) {
+        vec2 Point = Corners[i];
+        vec2 WorldPoint = {
+            CosRotation * Point.X - SinRotation * Point.Y + XForm.Pos.X,
+            SinRotation * Point.X + CosRotation * Point.Y + XForm.Pos.Y
+        };
+        
+        Corners[i] = WorldToCanvasPoint(Camera, WorldPoint);
+    }
     
-    glTexCoord2f(1, lerp(0, 1, DoFlip));
-    V= WorldToCanvasPoint(Camera, TransformPoint(XForm, vec2{QuadSize.X, 0} - Center));
-    glVertex3f(V.X, V.Y, Z);
-	
-    glTexCoord2f(1, lerp(1, 0, DoFlip));
-    V = WorldToCanvasPoint(Camera, TransformPoint(XForm, QuadSize - Center));
-    glVertex3f(V.X, V.Y, Z);
-	
-    glTexCoord2f(0, lerp(1, 0, DoFlip));
-    V = WorldToCanvasPoint(Camera, TransformPoint(XForm, vec2{0, QuadSize.Y} - Center));
-    glVertex3f(V.X, V.Y, Z);
+    //assuming our textures are flipped        
+    vec2 UVMin = { FillTexture.UVMin.X, lerp(FillTexture.UVMin.Y, FillTexture.UVMax.Y, DoFlip) };
+    vec2 UVMax = { FillTexture.UVMax.X, lerp(FillTexture.UVMax.Y, FillTexture.UVMin.Y, DoFlip) };
     
-    glEnd();
+    PushSprite(&Global_Sprite_Batch, FillTexture.Object, Corners, UVMin, UVMax, FillColor, Z);
 }
 
 void DrawCircle(camera Camera, transform XForm, color FillColor = {0.7f, 0.0f, 0.0f, 1.0f}, bool IsFilled = true, u32 N = 16, f32 Z = 0) {
@@ -234,7 +479,8 @@ texture LoadTexture(u8 *Data, s32 Width, s32 Height, u8 BytesPerPixel, GLenum Fi
     if (FlipY)
     {
         u32 RowByteCount = Width * BytesPerPixel;
-        u8 *tmp = new u8[RowByteCount];
+        auto Temporary = BeginTemporaryMemory(&Global_Frame_Arena);
+        u8 *tmp = PUSH_ARRAY(&Global_Frame_Arena, u8, RowByteCount);
         
         for (u32 y = 0; y < Height / 2; y++)
         {
@@ -243,7 +489,7 @@ texture LoadTexture(u8 *Data, s32 Width, s32 Height, u8 BytesPerPixel, GLenum Fi
             memcpy(Data + (Height - 1 - y) * RowByteCount, tmp, RowByteCount);
         }
         
-        delete[] tmp;
+        EndTemporaryMemory(Temporary);
     }
     
     texture Result;
@@ -268,6 +514,8 @@ texture LoadTexture(u8 *Data, s32 Width, s32 Height, u8 BytesPerPixel, GLenum Fi
     
     Result.Width = Width;
     Result.Height = Height;
+    Result.UVMin = { 0, 0 };
+    Result.UVMax = { 1, 1 };
     
     return Result;
 }
@@ -286,6 +534,166 @@ texture LoadTexture(const char *Path, GLenum filter = GL_LINEAR){
     return Result;
 }
 
+// texture atlas
+// packs images into as few textures as possible, so sprites and ui can be
+// batched with one bind. images are placed on shelves sorted by height and
+// get a 1 texel border copied from their edges, so linear filtering doesn't
+// bleed the neighbours in.
+
+const s32 Atlas_Border = 1;
+
+struct atlas_image {
+    const char *Path;
+    texture *Texture;
+};
+
+struct atlas_page {
+    u8 *Pixels;
+    s32 Size;
+    s32 ShelfX, ShelfY, ShelfHeight;
+    
+    // images placed on this page, their uvs are known once it's uploaded
+    u32 *ImageIndices;
+    s32 *ImageX, *ImageY;
+    u32 ImageCount;
+};
+
+// copies the RGBA32 surface into the page with a border and returns false if it doesn't fit
+bool AtlasPlace(atlas_page *Page, SDL_Surface *Surface, u32 ImageIndex) {
+    s32 CellWidth  = Surface->w + 2 * Atlas_Border;
+    s32 CellHeight = Surface->h + 2 * Atlas_Border;
+    
+    if (Page->ShelfX + CellWidth > Page->Size) {
+        Page->ShelfY += Page->ShelfHeight;
+        Page->ShelfX = 0;
+        Page->ShelfHeight = 0;
+    }
+    
+    if ((CellWidth > Page->Size) || (Page->ShelfY + CellHeight > Page->Size))
+        return false;
+    
+    s32 X = Page->ShelfX + Atlas_Border;
+    s32 Y = Page->ShelfY + Atlas_Border;
+    
+    for (s32 CellY = -Atlas_Border; CellY < Surface->h + Atlas_Border; CellY++) {
+        s32 SourceY = CLAMP(CellY, 0, Surface->h - 1);
+        u32 *SourceRow = (u32 *) ((u8 *) Surface->pixels + SourceY * Surface->pitch);
+        u32 *DestRow = (u32 *) Page->Pixels + (Y + CellY) * Page->Size + X;
+        
+        for (s32 CellX = -Atlas_Border; CellX < Surface->w + Atlas_Border; CellX++) {
+            DestRow[CellX] = SourceRow[CLAMP(CellX, 0, Surface->w - 1)];
+        }
+    }
+    
+    Page->ImageIndices[Page->ImageCount] = ImageIndex;
+    Page->ImageX[Page->ImageCount] = X;
+    Page->ImageY[Page->ImageCount] = Y;
+    Page->ImageCount++;
+    
+    Page->ShelfX += CellWidth;
+    Page->ShelfHeight = MAX(Page->ShelfHeight, CellHeight);
+    
+    return true;
+}
+
+void AtlasUpload(atlas_page *Page, atlas_image *Images, SDL_Surface **Surfaces, GLenum Filter) {
+    if (Page->ImageCount == 0)
+        return;
+    
+    // pixels are top down, LoadTexture flips them like every other texture
+    texture Atlas = LoadTexture(Page->Pixels, Page->Size, Page->Size, 4, Filter);
+    
+    for (u32 i = 0; i < Page->ImageCount; i++) {
+        u32 ImageIndex = Page->ImageIndices[i];
+        auto Surface = Surfaces[ImageIndex];
+        s32 FlippedY = Page->Size - Page->ImageY[i] - Surface->h;
+        
+        texture *Texture = Images[ImageIndex].Texture;
+        Texture->Object = Atlas.Object;
+        Texture->Width  = Surface->w;
+        Texture->Height = Surface->h;
+        Texture->UVMin  = { Page->ImageX[i] / (f32) Page->Size, FlippedY / (f32) Page->Size };
+        Texture->UVMax  = { (Page->ImageX[i] + Surface->w) / (f32) Page->Size, (FlippedY + Surface->h) / (f32) Page->Size };
+    }
+    
+    memset(Page->Pixels, 0, sizeof(u32) * Page->Size * Page->Size);
+    Page->ShelfX = 0;
+    Page->ShelfY = 0;
+    Page->ShelfHeight = 0;
+    Page->ImageCount = 0;
+}
+
+// loads all images into AtlasSize x AtlasSize textures and returns how many were created.
+// images that don't fit into an empty atlas get a texture of their own
+u32 LoadTextureAtlases(atlas_image *Images, u32 ImageCount, s32 AtlasSize = 2048, GLenum Filter = GL_LINEAR) {
+    auto Surfaces = new SDL_Surface*[ImageCount];
+    auto Order = new u32[ImageCount];
+    
+    for (u32 i = 0; i < ImageCount; i++) {
+        // paletted and rgb images are converted, so every texel is 4 bytes
+        SDL_Surface *Loaded = IMG_Load(Images[i].Path);
+        assert(Loaded);
+        
+        Surfaces[i] = SDL_ConvertSurfaceFormat(Loaded, SDL_PIXELFORMAT_RGBA32, 0);
+        assert(Surfaces[i]);
+        SDL_FreeSurface(Loaded);
+        
+        // insertion sort by height, tallest first
+        u32 j = i;
+        while ((j > 0) && (Surfaces[Order[j - 1]]->h < Surfaces[i]->h)) {
+            Order[j] = Order[j - 1];
+            j--;
+        }
+        Order[j] = i;
+    }
+    
+    atlas_page Page = {};
+    Page.Size = AtlasSize;
+    Page.Pixels = new u8[sizeof(u32) * AtlasSize * AtlasSize]();
+    Page.ImageIndices = new u32[ImageCount];
+    Page.ImageX = new s32[ImageCount];
+    Page.ImageY = new s32[ImageCount];
+    
+    u32 AtlasCount = 0;
+    
+    for (u32 i = 0; i < ImageCount; i++) {
+        u32 ImageIndex = Order[i];
+        auto Surface = Surfaces[ImageIndex];
+        
+        if ((Surface->w + 2 * Atlas_Border > AtlasSize) || (Surface->h + 2 * Atlas_Border > AtlasSize)) {
+            *Images[ImageIndex].Texture = LoadTexture((u8 *) Surface->pixels, Surface->w, Surface->h, 4, Filter);
+            AtlasCount++;
+            continue;
+        }
+        
+        if (!AtlasPlace(&Page, Surface, ImageIndex)) {
+            AtlasUpload(&Page, Images, Surfaces, Filter);
+            AtlasCount++;
+            
+            bool WasPlaced = AtlasPlace(&Page, Surface, ImageIndex);
+            assert(WasPlaced);
+        }
+    }
+    
+    if (Page.ImageCount > 0) {
+        AtlasUpload(&Page, Images, Surfaces, Filter);
+        AtlasCount++;
+    }
+    
+    for (u32 i = 0; i < ImageCount; i++) {
+        SDL_FreeSurface(Surfaces[i]);
+    }
+    
+    delete[] Page.Pixels;
+    delete[] Page.ImageIndices;
+    delete[] Page.ImageX;
+    delete[] Page.ImageY;
+    delete[] Surfaces;
+    delete[] Order;
+    
+    return AtlasCount;
+}
+
 void DrawHistogram(histogram H) {
     glBegin(GL_LINES);
     
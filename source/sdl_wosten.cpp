@@ -1,4 +1,8 @@
 // #define DEBUG_UI
+// #define STRESS_TEST
+// #define SIMD_COLLISION
+// #define PROFILER
+// #define ALLOCATION_TRACKING
 
 #include "SDL.h"
 #include <stdio.h>
@@ -13,11 +17,21 @@
 #include <time.h>
 //#include <cstring>
 
+#if !defined WIN32
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "defines.h"
 #include "render.h"
 #include "ui.h"
 
 #include "ui_control.h"
+#include "broadphase.h"
+#include "random.h"
+#include "allocation_tracking.h"
 
 #define UI_FILE_ID ((u64)1)
 
@@ -42,6 +56,7 @@ enum entity_type {
     Entity_Type_Bullet,
     Entity_Type_Bomb,
     Entity_Type_Powerup,    
+    Entity_Type_Enemy_Bullet, // after fly, so bullets are updated in the step they are fired
     
     Entity_Type_Count
 };
@@ -50,7 +65,18 @@ enum path_type {
     Path_Type_Stop,       
     Path_Type_Loop,       
     Path_Type_Reverse,    
-    Path_Type_Follow      
+    Path_Type_Follow,
+    
+    Path_Type_Count
+};
+
+// how a path gets from one point to the next, independent of the path_type
+enum path_curve {
+    Path_Curve_Linear,
+    Path_Curve_Catmull_Rom, // smooth curve through all points
+    Path_Curve_Bezier,      // points 0, 3, 6, ... are on the path, the two points between are the control points
+    
+    Path_Curve_Count
 };
 
 enum sfx {
@@ -98,50 +124,283 @@ bool WasReleased(key Key) {
     return (!Key.IsPressed && Key.HasChanged);
 }
 
+// replays store the seed and the input of every simulation step.
+// the input is packed into one u32 per step and run length encoded,
+// mouse position is not stored since the game simulation doesn't use it.
+
+const u32 Replay_Magic   = 'W' | ('R' << 8) | ('P' << 16) | ('L' << 24);
+const u32 Replay_Version = 1;
+
+struct replay_header {
+    u32 Magic;
+    u32 Version;
+    u64 Seed;
+    u32 TickCount;
+    u32 RunCount;
+    u32 Checksum; // GameStateChecksum after the last step
+};
+
+struct replay_run {
+    u32 Keys; // IsPressed in the low 16 bits, HasChanged in the high 16 bits
+    u32 TickCount;
+};
+
+enum replay_mode {
+    Replay_Mode_None,
+    Replay_Mode_Record,
+    Replay_Mode_Play
+};
+
+struct replay {
+    replay_mode Mode;
+    char *FileName;
+    
+    u64 Seed;
+    u32 TickCount;
+    u32 Checksum;
+    
+    replay_run *Runs;
+    u32 RunCount, RunCapacity;
+    
+    // playback cursor
+    u32 PlayRunIndex, PlayTickInRun;
+};
+
+u32 PackInput(input Input) {
+    u32 Result = 0;
+    
+    for (u32 i = 0; i < ARRAY_COUNT(Input.Keys); i++) {
+        if (Input.Keys[i].IsPressed)
+            Result |= FLAG(i);
+        
+        if (Input.Keys[i].HasChanged)
+            Result |= FLAG(i + 16);
+    }
+    
+    return Result;
+}
+
+input UnpackInput(u32 Packed) {
+    input Result = {};
+    
+    for (u32 i = 0; i < ARRAY_COUNT(Result.Keys); i++) {
+        Result.Keys[i].IsPressed  = (Packed & FLAG(i)) != 0;
+        Result.Keys[i].HasChanged = (Packed & FLAG(i + 16)) != 0;
+    }
+    
+    return Result;
+}
+
+void StartRecording(replay *Replay, char *FileName, u64 Seed) {
+    Replay->Mode = Replay_Mode_Record;
+    Replay->FileName = FileName;
+    Replay->Seed = Seed;
+    Replay->TickCount = 0;
+    Replay->RunCount = 0;
+}
+
+void RecordInput(replay *Replay, input Input) {
+    assert(Replay->Mode == Replay_Mode_Record);
+    
+    u32 Keys = PackInput(Input);
+    Replay->TickCount++;
+    
+    if ((Replay->RunCount > 0) && (Replay->Runs[Replay->RunCount - 1].Keys == Keys)) {
+        Replay->Runs[Replay->RunCount - 1].TickCount++;
+        return;
+    }
+    
+    if (Replay->RunCount == Replay->RunCapacity) {
+        u32 NewCapacity = MAX(256, Replay->RunCapacity * 2);
+        auto NewRuns = new replay_run[NewCapacity];
+        memcpy(NewRuns, Replay->Runs, sizeof(replay_run) * Replay->RunCount);
+        delete[] Replay->Runs;
+        
+        Replay->Runs = NewRuns;
+        Replay->RunCapacity = NewCapacity;
+    }
+    
+    Replay->Runs[Replay->RunCount++] = { Keys, 1 };
+}
+
+// returns false once all recorded steps are played back
+bool NextReplayInput(replay *Replay, input *Input) {
+    assert(Replay->Mode == Replay_Mode_Play);
+    
+    while ((Replay->PlayRunIndex < Replay->RunCount) && (Replay->PlayTickInRun >= Replay->Runs[Replay->PlayRunIndex].TickCount)) {
+        Replay->PlayRunIndex++;
+        Replay->PlayTickInRun = 0;
+    }
+    
+    if (Replay->PlayRunIndex == Replay->RunCount)
+        return false;
+    
+    *Input = UnpackInput(Replay->Runs[Replay->PlayRunIndex].Keys);
+    Replay->PlayTickInRun++;
+    
+    return true;
+}
+
+void SaveReplay(replay *Replay) {
+    SDL_RWops* File = SDL_RWFromFile(Replay->FileName, "wb");
+    assert(File);
+    
+    replay_header Header = { Replay_Magic, Replay_Version, Replay->Seed, Replay->TickCount, Replay->RunCount, Replay->Checksum };
+    
+    size_t WriteObjectCount = SDL_RWwrite(File, &Header, sizeof(Header), 1);
+    assert(WriteObjectCount == 1);
+    
+    if (Replay->RunCount > 0) {
+        WriteObjectCount = SDL_RWwrite(File, Replay->Runs, sizeof(replay_run), Replay->RunCount);
+        assert(WriteObjectCount == Replay->RunCount);
+    }
+    
+    SDL_RWclose(File);
+}
+
+bool LoadReplay(replay *Replay, char *FileName) {
+    SDL_RWops* File = SDL_RWFromFile(FileName, "rb");
+    
+    if (File == NULL) {
+        printf("could not open replay %s\n", FileName);
+        return false;
+    }
+    
+    replay_header Header;
+    size_t ReadObjectCount = SDL_RWread(File, &Header, sizeof(Header), 1);
+    
+    if ((ReadObjectCount != 1) || (Header.Magic != Replay_Magic) || (Header.Version != Replay_Version)) {
+        printf("%s is not a replay or has an unsupported version\n", FileName);
+        SDL_RWclose(File);
+        return false;
+    }
+    
+    // check the run count against the file before trusting it with an allocation
+    Sint64 FileSize = SDL_RWsize(File);
+    if ((FileSize < (Sint64) sizeof(Header)) || ((u64) Header.RunCount > (u64) (FileSize - sizeof(Header)) / sizeof(replay_run))) {
+        printf("%s is truncated or corrupt\n", FileName);
+        SDL_RWclose(File);
+        return false;
+    }
+    
+    *Replay = {};
+    Replay->Mode = Replay_Mode_Play;
+    Replay->FileName = FileName;
+    Replay->Seed = Header.Seed;
+    Replay->TickCount = Header.TickCount;
+    Replay->RunCount = Header.RunCount;
+    Replay->Checksum = Header.Checksum;
+    Replay->RunCapacity = Header.RunCount;
+    Replay->Runs = new replay_run[Header.RunCount];
+    
+    ReadObjectCount = SDL_RWread(File, Replay->Runs, sizeof(replay_run), Header.RunCount);
+    
+    if (ReadObjectCount != Header.RunCount) {
+        printf("%s is truncated or corrupt\n", FileName);
+        delete[] Replay->Runs;
+        *Replay = {};
+        SDL_RWclose(File);
+        return false;
+    }
+    
+    SDL_RWclose(File);
+    return true;
+}
+
 const f32 Fly_Min_Fire_Interval = 0.8f;
 const f32 Fly_Max_Fire_Interval = 1.7f;
 
 const f32 Powerup_Collect_Radius = 0.1f;
 const f32 Powerup_Magnet_Speed   = 0.5f;
 
+// the game simulation always advances in steps of Sim_Delta_Seconds,
+// rendering interpolates between the last two steps
+const f32 Sim_Delta_Seconds = 1.0f / 120.0f;
+const f32 Max_Sim_Catch_Up_Seconds = 0.25f;
+
+#ifdef STRESS_TEST
+const u32 Stress_Bullet_Count = 4000;
+const u32 Stress_Fly_Count    = 200;
+#endif
+
 struct path_point{
     vec2 Position;
     f32 Time;
 };
 
-#define template_array_name      path_template
+#define template_array_name      path_points
 #define template_array_data_type path_point
 #define template_array_is_buffer 
-#define template_array_static_count 10
 #include "template_array.h"
 
-struct entity_spawn_info;
+// the points of a path are Count points starting at First in the PathPoints of the level,
+// Capacity points are reserved there (see PushPathPoint). spawned entities share the
+// points of their blueprint.
+struct path_point_range {
+    u32 First, Count, Capacity;
+};
+
+// a path sampled at Trajectory_Samples_Per_Second from its spawn time on, see BakeTrajectory.
+// positions are quantized to 16 bits inside the bounds of the path points.
+// followers have no samples of their own and use the trajectory of their FollowRoot.
+
+const f32 Trajectory_Samples_Per_Second = 60.0f;
+
+struct trajectory_sample {
+    u16 X, Y;
+};
+
+#define template_array_name      trajectory_samples
+#define template_array_data_type trajectory_sample
+#define template_array_is_buffer 
+#include "template_array.h"
+
+enum trajectory_mode {
+    Trajectory_Mode_Clamp,  // stays at the end after Period
+    Trajectory_Mode_Wrap,   // repeats every Period
+    Trajectory_Mode_Mirror, // goes back to the start after Period, then forward again
+};
+
+struct trajectory {
+    // in the TrajectorySamples of the level, like path_point_range
+    u32 FirstSample, SampleCount, SampleCapacity; 
+    trajectory_mode Mode;
+    f32 Period;
+    vec2 Min, Scale;
+};
 
 struct path {
-    path_template Points;
+    path_point_range Points;
     path_type Type;
+    path_curve Curve;
     f32 TransitionTime; //time it takes to go back to the first point if Path_Type_Loop is chosen or the delay to the leading entity if it is Path_Type_Follow 
     u64 IDFollowing;
-    entity_spawn_info *Following;
+    u32 Following; // index + 1 of the leader in the SpawnInfos of the level, 0 if none
+    trajectory Trajectory;
+    
+    // Path_Type_Follow only, set by ResolveFollowChains and ResolveFollowers:
+    // the first leader that isn't following anyone (index + 1 like Following) and the summed delays up to it
+    u32 FollowRoot;
+    f32 FollowDelay;
 };
 
+// what the per frame loops touch, the rest is in entity_cold.
+// flies share the path of the spawn info they were spawned from.
 struct entity {
     transform XForm;
+    transform PrevXForm; // XForm before the last simulation step, only valid if HasPrevXForm
+    bool HasPrevXForm;
     f32 CollisionRadius;
-    s32 Hp, MaxHp;
     
     entity_type Type;
     bool MarkedForDeletion;
-    u32 CollisionTypeMask;
-    f32 BlinkTime, BlinkDuration;
     vec2 RelativeDrawCenter;
-    f32 SpawnTime;
     
     union {
         struct {
             vec2 Velocity;
             f32 FireCountdown;
-            path Path;            
+            u32 SpawnInfo; // index + 1 in the SpawnInfos of the level, 0 if not spawned from one
         } fly;
         
         struct {
@@ -155,36 +414,338 @@ struct entity {
     };    
 };
 
-#define template_array_name entity_buffer
-#define template_array_data_type entity
-#define template_array_is_buffer
-#include "template_array.h"
+// only touched on hits and when drawing, kept next to the entities in their chunk
+struct entity_cold {
+    s32 Hp, MaxHp;
+    f32 BlinkEndTime; // Level.Time the blink of the last hit ends, so nothing counts it down
+    f32 BlinkDuration;
+};
+
+// entities live in fixed size chunks that never move, so entity pointers stay valid
+// until the entity is removed. Live holds the slot of every living entity and is
+// compacted with swap remove, so iteration only touches living entities.
+// Live is sorted by entity_type, each type is one contiguous range (see TypeRange),
+// so the archetype kernels run over entities of a single type.
+// a handle stays valid until its entity is removed, the generation of the slot
+// is bumped on every removal.
+
+const u32 Entity_Chunk_Size = 256;
+
+struct entity_handle {
+    u32 Slot;
+    u32 Generation; // 0 is never used, so a zeroed handle is invalid
+};
+
+struct entity_chunk {
+    entity Entities[Entity_Chunk_Size];
+    entity_cold Colds[Entity_Chunk_Size];
+    u32 Generations[Entity_Chunk_Size];
+};
+
+struct entity_pool {
+    entity_chunk **Chunks;
+    u32 ChunkCount, ChunkCapacity;
+    
+    u32 *Live;
+    u32 Count;
+    u32 TypeEnds[Entity_Type_Count]; // entities of type t are at [TypeEnds[t - 1], TypeEnds[t]) in Live
+    
+    u32 *FreeSlots;
+    u32 FreeCount;
+    
+    // slots above this were never handed out
+    u32 UsedSlotCount;
+};
+
+u32 Capacity(entity_pool *Pool) {
+    return Pool->ChunkCount * Entity_Chunk_Size;
+}
+
+entity *SlotEntity(entity_pool *Pool, u32 Slot) {
+    return Pool->Chunks[Slot / Entity_Chunk_Size]->Entities + (Slot % Entity_Chunk_Size);
+}
 
-entity* NextEntity(entity_buffer *Buffer){
-    auto Result = Push(Buffer);
-    if (Result != NULL) {
-        *Result = {};
+entity_cold *SlotCold(entity_pool *Pool, u32 Slot) {
+    return Pool->Chunks[Slot / Entity_Chunk_Size]->Colds + (Slot % Entity_Chunk_Size);
+}
+
+u32 *SlotGeneration(entity_pool *Pool, u32 Slot) {
+    return Pool->Chunks[Slot / Entity_Chunk_Size]->Generations + (Slot % Entity_Chunk_Size);
+}
+
+// LiveIndex < Pool->Count, changes when entities are removed
+entity *EntityAt(entity_pool *Pool, u32 LiveIndex) {
+    assert(LiveIndex < Pool->Count);
+    return SlotEntity(Pool, Pool->Live[LiveIndex]);
+}
+
+entity_cold *ColdAt(entity_pool *Pool, u32 LiveIndex) {
+    assert(LiveIndex < Pool->Count);
+    return SlotCold(Pool, Pool->Live[LiveIndex]);
+}
+
+struct entity_range {
+    u32 First, End; // live indices
+};
+
+entity_range TypeRange(entity_pool *Pool, entity_type Type) {
+    entity_range Result;
+    Result.First = (Type > 0) ? Pool->TypeEnds[Type - 1] : 0;
+    Result.End   = Pool->TypeEnds[Type];
+    
+    return Result;
+}
+
+entity_handle HandleAt(entity_pool *Pool, u32 LiveIndex) {
+    assert(LiveIndex < Pool->Count);
+    u32 Slot = Pool->Live[LiveIndex];
+    
+    return { Slot, *SlotGeneration(Pool, Slot) };
+}
+
+entity *GetEntity(entity_pool *Pool, entity_handle Handle) {
+    if ((Handle.Generation == 0) || (Handle.Slot >= Pool->UsedSlotCount))
+        return NULL;
+    
+    if (*SlotGeneration(Pool, Handle.Slot) != Handle.Generation)
+        return NULL;
+    
+    return SlotEntity(Pool, Handle.Slot);
+}
+
+void AddChunk(entity_pool *Pool) {
+    if (Pool->ChunkCount == Pool->ChunkCapacity) {
+        u32 NewChunkCapacity = MAX(4, Pool->ChunkCapacity * 2);
+        auto NewChunks = new entity_chunk*[NewChunkCapacity];
+        memcpy(NewChunks, Pool->Chunks, sizeof(entity_chunk*) * Pool->ChunkCount);
+        delete[] Pool->Chunks;
+        Pool->Chunks = NewChunks;
+        Pool->ChunkCapacity = NewChunkCapacity;
+    }
+    
+    auto Chunk = new entity_chunk;
+    for (u32 i = 0; i < Entity_Chunk_Size; i++) {
+        Chunk->Generations[i] = 1;
+    }
+    
+    Pool->Chunks[Pool->ChunkCount++] = Chunk;
+    
+    u32 NewCapacity = Capacity(Pool);
+    
+    auto NewLive = new u32[NewCapacity];
+    memcpy(NewLive, Pool->Live, sizeof(u32) * Pool->Count);
+    delete[] Pool->Live;
+    Pool->Live = NewLive;
+    
+    auto NewFreeSlots = new u32[NewCapacity];
+    memcpy(NewFreeSlots, Pool->FreeSlots, sizeof(u32) * Pool->FreeCount);
+    delete[] Pool->FreeSlots;
+    Pool->FreeSlots = NewFreeSlots;
+}
+
+// the type can't change later, it decides the range of Live the entity is in.
+// never returns NULL, a full pool gets another chunk
+entity* NextEntity(entity_pool *Pool, entity_type Type, entity_handle *Handle = NULL, entity_cold **Cold = NULL){
+    u32 Slot;
+    
+    if (Pool->FreeCount > 0) {
+        Slot = Pool->FreeSlots[--(Pool->FreeCount)];
+    }
+    else {
+        if (Pool->UsedSlotCount == Capacity(Pool))
+            AddChunk(Pool);
+        
+        Slot = (Pool->UsedSlotCount)++;
+    }
+    
+    // open a gap at the end of the range of Type by moving the first entity
+    // of every following range to its end
+    u32 Gap = (Pool->Count)++;
+    for (u32 Other = Entity_Type_Count - 1; Other > (u32) Type; Other--) {
+        u32 First = TypeRange(Pool, (entity_type) Other).First;
+        Pool->Live[Gap] = Pool->Live[First];
+        Pool->TypeEnds[Other]++;
+        Gap = First;
     }
     
+    assert(Gap == Pool->TypeEnds[Type]);
+    Pool->Live[Gap] = Slot;
+    Pool->TypeEnds[Type]++;
+    
+    auto Result = SlotEntity(Pool, Slot);
+    *Result = {};
+    Result->Type = Type;
+    *SlotCold(Pool, Slot) = {};
+    
+    if (Cold)
+        *Cold = SlotCold(Pool, Slot);
+    
+    if (Handle)
+        *Handle = { Slot, *SlotGeneration(Pool, Slot) };
+    
     return Result;
 }
 
+// the last entity of the same type takes the place of the removed one,
+// the gap is passed on to the end by moving the last entity of every following range
+void RemoveEntityAt(entity_pool *Pool, u32 LiveIndex) {
+    assert(LiveIndex < Pool->Count);
+    u32 Slot = Pool->Live[LiveIndex];
+    u32 Type = SlotEntity(Pool, Slot)->Type;
+    
+    assert((TypeRange(Pool, (entity_type) Type).First <= LiveIndex) && (LiveIndex < Pool->TypeEnds[Type]));
+    
+    (*SlotGeneration(Pool, Slot))++;
+    Pool->FreeSlots[(Pool->FreeCount)++] = Slot;
+    
+    u32 Gap = LiveIndex;
+    for (; Type < Entity_Type_Count; Type++) {
+        u32 Last = --(Pool->TypeEnds[Type]);
+        Pool->Live[Gap] = Pool->Live[Last];
+        Gap = Last;
+    }
+    
+    Pool->Count--;
+}
+
+void RemoveMarkedEntities(entity_pool *Pool) {
+    PROFILE_FUNCTION();
+    
+    u32 i = 0;
+    while (i < Pool->Count) {
+        if (EntityAt(Pool, i)->MarkedForDeletion) {
+            RemoveEntityAt(Pool, i);
+        }
+        else{ 
+            i++;
+        }
+    }
+}
+
+void Clear(entity_pool *Pool) {
+    while (Pool->Count > 0) {
+        RemoveEntityAt(Pool, Pool->Count - 1);
+    }
+}
+
+// kept over all steps, initGame doesn't reset them
+struct collision_stats {
+    u32 PairCount;     // last step
+    u32 ConsumedCount; // last step, pairs dropped because an entity was already used up by another one
+    u32 MaxPairCount;
+    
+    u64 TotalPairCount, TotalConsumedCount;
+};
+
+// only used within a frame, the entities can't be removed before RemoveMarkedEntities
 struct collision {
     entity *Entities[2];
+    entity_cold *Colds[2];
 };
 
 struct entity_spawn_info {
     u64 ID;
+    f32 SpawnTime;
     entity Blueprint;
-    bool WasNotSpawned;
+    entity_cold Cold;
+    path Path; // flies only, shared by all flies spawned from this info
 };
 
 #define template_array_name      entity_spawn_infos
 #define template_array_data_type entity_spawn_info
 #define template_array_is_buffer 
-#define template_array_static_count 256
 #include "template_array.h"
 
+// indices of the spawn infos sorted by SpawnTime (equal times keep their order).
+// everything before Cursor has spawned, so a frame only looks at what is due.
+struct spawn_queue {
+    u32 *Indices;
+    u32 Count, Capacity;
+    u32 Cursor;
+};
+
+f32 SpawnTimeAt(spawn_queue *Queue, entity_spawn_infos *Infos, u32 QueueIndex) {
+    return Infos->Base[Queue->Indices[QueueIndex]].SpawnTime;
+}
+
+// first queue index with a SpawnTime > Time (or >= Time if IncludeEqual is false)
+u32 SpawnQueueSearch(spawn_queue *Queue, entity_spawn_infos *Infos, f32 Time, bool IncludeEqual = true) {
+    u32 Begin = 0;
+    u32 End = Queue->Count;
+    
+    while (Begin < End) {
+        u32 Middle = Begin + (End - Begin) / 2;
+        f32 MiddleTime = SpawnTimeAt(Queue, Infos, Middle);
+        
+        if ((MiddleTime < Time) || (IncludeEqual && (MiddleTime == Time)))
+            Begin = Middle + 1;
+        else
+            End = Middle;
+    }
+    
+    return Begin;
+}
+
+void SpawnQueueInsert(spawn_queue *Queue, entity_spawn_infos *Infos, u32 InfoIndex) {
+    if (Queue->Count == Queue->Capacity) {
+        u32 NewCapacity = MAX(64, Queue->Capacity * 2);
+        auto NewIndices = new u32[NewCapacity];
+        memcpy(NewIndices, Queue->Indices, sizeof(u32) * Queue->Count);
+        delete[] Queue->Indices;
+        
+        Queue->Indices = NewIndices;
+        Queue->Capacity = NewCapacity;
+    }
+    
+    u32 QueueIndex = SpawnQueueSearch(Queue, Infos, Infos->Base[InfoIndex].SpawnTime);
+    memmove(Queue->Indices + QueueIndex + 1, Queue->Indices + QueueIndex, sizeof(u32) * (Queue->Count - QueueIndex));
+    Queue->Indices[QueueIndex] = InfoIndex;
+    Queue->Count++;
+    
+    if (QueueIndex < Queue->Cursor)
+        Queue->Cursor++;
+}
+
+// if MovedInfoIndex != InfoIndex, the info at MovedInfoIndex was moved to InfoIndex
+void SpawnQueueRemove(spawn_queue *Queue, u32 InfoIndex, u32 MovedInfoIndex) {
+    u32 QueueIndex = 0;
+    while ((QueueIndex < Queue->Count) && (Queue->Indices[QueueIndex] != InfoIndex))
+        QueueIndex++;
+    
+    assert(QueueIndex < Queue->Count);
+    
+    memmove(Queue->Indices + QueueIndex, Queue->Indices + QueueIndex + 1, sizeof(u32) * (Queue->Count - QueueIndex - 1));
+    Queue->Count--;
+    
+    if (QueueIndex < Queue->Cursor)
+        Queue->Cursor--;
+    
+    for (u32 i = 0; i < Queue->Count; i++) {
+        if (Queue->Indices[i] == MovedInfoIndex)
+            Queue->Indices[i] = InfoIndex;
+    }
+}
+
+// call after changing the SpawnTime of an info
+void SpawnQueueUpdate(spawn_queue *Queue, entity_spawn_infos *Infos, u32 InfoIndex) {
+    SpawnQueueRemove(Queue, InfoIndex, InfoIndex);
+    SpawnQueueInsert(Queue, Infos, InfoIndex);
+}
+
+// as if the level was played up to Time, infos spawning exactly at Time are still due
+void SpawnQueueSeek(spawn_queue *Queue, entity_spawn_infos *Infos, f32 Time) {
+    Queue->Cursor = SpawnQueueSearch(Queue, Infos, Time, false);
+}
+
+void SpawnQueueBuild(spawn_queue *Queue, entity_spawn_infos *Infos) {
+    Queue->Count = 0;
+    Queue->Cursor = 0;
+    
+    for (u32 i = 0; i < Infos->Count; i++) {
+        SpawnQueueInsert(Queue, Infos, i);
+    }
+}
+
 struct assets {
     //doesn't include bomb texture or font
     texture LevelLayer1;
@@ -209,6 +770,8 @@ struct assets {
     texture PathReverseButtonTexture;
     texture PathFollowButtonTexture;
     
+    u32 AtlasCount;
+    
     font DefaultFont;
     
     Mix_Music *Bgm;
@@ -217,20 +780,396 @@ struct assets {
 };
 
 
+// a level file is a header, a section table and the sections. spawn infos and
+// path points only refer to each other by index, so a loaded (or mapped) file is
+// used in place. loaders skip section types they don't know, any change to the
+// layout of a known section needs a new Level_File_Version.
+
+const u32 Level_File_Magic   = 'W' | ('L' << 8) | ('V' << 16) | ('L' << 24);
+const u32 Level_File_Version = 5;
+const u32 Level_File_Section_Alignment = 16;
+
+enum level_section_type {
+    Level_Section_Spawn_Infos,
+    Level_Section_Path_Points,
+    Level_Section_Count,
+};
+
+struct level_file_section {
+    u32 Type; // level_section_type
+    u32 ElementSize;
+    u64 Count;
+    u64 Offset; // from the start of the file
+};
+
+struct level_file_header {
+    u32 Magic;
+    u32 Version;
+    u32 SectionCount; // the section table follows the header
+    f32 Duration;
+    f32 WorldHeight;
+    f32 LayersWorldUnitsPerPixels[2];
+};
+
+// ID -> index hash of the spawn infos and the followers of every spawn info.
+// built on load and kept up to date by PushSpawnInfo, SetFollowing and RemoveSpawnInfo,
+// so follow links can be resolved and removed without scanning all spawn infos.
+struct spawn_lookup {
+    // open addressing with linear probing, ID 0 marks a free slot.
+    // at most half of the slots are used
+    u64 *IDs;
+    u32 *Indices;
+    u32 SlotCount; // power of two
+    u32 IDCount;
+    u64 NextID;
+    
+    // singly linked lists through the spawn infos following the same leader,
+    // index + 1 like path.Following, 0 ends a list
+    u32 *FirstFollower;
+    u32 *NextFollower;
+    u32 FollowerCapacity;
+};
+
+u32 SpawnLookupSlot(spawn_lookup *Lookup, u64 ID) {
+    return (u32) ((ID * 11400714819323198485ull) >> 32) & (Lookup->SlotCount - 1);
+}
+
+// returns the index + 1 of the spawn info with ID, 0 if there is none
+u32 SpawnLookupFind(spawn_lookup *Lookup, u64 ID) {
+    if ((ID == 0) || (Lookup->SlotCount == 0))
+        return 0;
+    
+    for (u32 Slot = SpawnLookupSlot(Lookup, ID); Lookup->IDs[Slot] != 0; Slot = (Slot + 1) & (Lookup->SlotCount - 1)) {
+        if (Lookup->IDs[Slot] == ID)
+            return Lookup->Indices[Slot] + 1;
+    }
+    
+    return 0;
+}
+
+void SpawnLookupInsert(spawn_lookup *Lookup, u64 ID, u32 Index);
+
+void SpawnLookupRehash(spawn_lookup *Lookup, u32 NewSlotCount) {
+    u64 *OldIDs = Lookup->IDs;
+    u32 *OldIndices = Lookup->Indices;
+    u32 OldSlotCount = Lookup->SlotCount;
+    
+    Lookup->IDs = new u64[NewSlotCount]();
+    Lookup->Indices = new u32[NewSlotCount];
+    Lookup->SlotCount = NewSlotCount;
+    Lookup->IDCount = 0;
+    
+    for (u32 i = 0; i < OldSlotCount; i++) {
+        if (OldIDs[i] != 0)
+            SpawnLookupInsert(Lookup, OldIDs[i], OldIndices[i]);
+    }
+    
+    delete[] OldIDs;
+    delete[] OldIndices;
+}
+
+// also used to change the index of an ID that is already there
+void SpawnLookupInsert(spawn_lookup *Lookup, u64 ID, u32 Index) {
+    assert(ID != 0);
+    
+    if ((Lookup->IDCount + 1) * 2 > Lookup->SlotCount)
+        SpawnLookupRehash(Lookup, MAX(256, Lookup->SlotCount * 2));
+    
+    u32 Slot = SpawnLookupSlot(Lookup, ID);
+    while ((Lookup->IDs[Slot] != 0) && (Lookup->IDs[Slot] != ID))
+        Slot = (Slot + 1) & (Lookup->SlotCount - 1);
+    
+    if (Lookup->IDs[Slot] == 0)
+        Lookup->IDCount++;
+    
+    Lookup->IDs[Slot] = ID;
+    Lookup->Indices[Slot] = Index;
+}
+
+void SpawnLookupRemove(spawn_lookup *Lookup, u64 ID) {
+    if ((ID == 0) || (Lookup->SlotCount == 0))
+        return;
+    
+    u32 Mask = Lookup->SlotCount - 1;
+    u32 Slot = SpawnLookupSlot(Lookup, ID);
+    
+    while (Lookup->IDs[Slot] != ID) {
+        if (Lookup->IDs[Slot] == 0)
+            return;
+        
+        Slot = (Slot + 1) & Mask;
+    }
+    
+    // shift following entries back into the hole, unless they are
+    // already between their home slot and the hole
+    u32 Hole = Slot;
+    for (u32 Next = (Hole + 1) & Mask; Lookup->IDs[Next] != 0; Next = (Next + 1) & Mask) {
+        u32 Home = SpawnLookupSlot(Lookup, Lookup->IDs[Next]);
+        
+        if (((Next - Home) & Mask) >= ((Next - Hole) & Mask)) {
+            Lookup->IDs[Hole] = Lookup->IDs[Next];
+            Lookup->Indices[Hole] = Lookup->Indices[Next];
+            Hole = Next;
+        }
+    }
+    
+    Lookup->IDs[Hole] = 0;
+    Lookup->IDCount--;
+}
+
+void LinkFollower(spawn_lookup *Lookup, u32 Leader, u32 FollowerIndex) {
+    if (Leader == 0)
+        return;
+    
+    Lookup->NextFollower[FollowerIndex] = Lookup->FirstFollower[Leader - 1];
+    Lookup->FirstFollower[Leader - 1] = FollowerIndex + 1;
+}
+
+void UnlinkFollower(spawn_lookup *Lookup, u32 Leader, u32 FollowerIndex) {
+    if (Leader == 0)
+        return;
+    
+    u32 *Link = &Lookup->FirstFollower[Leader - 1];
+    while (*Link != 0) {
+        if (*Link == FollowerIndex + 1) {
+            *Link = Lookup->NextFollower[FollowerIndex];
+            return;
+        }
+        
+        Link = &Lookup->NextFollower[*Link - 1];
+    }
+}
+
 struct level {
+    // the whole level file as loaded. the pools point into it until they have to
+    // grow, then they move into their own allocation
+    u8 *Memory;
+    usize MemorySize;
+    
     entity_spawn_infos SpawnInfos;
+    path_points PathPoints;
+    spawn_lookup Lookup;
+    
+    // baked on load, never saved
+    trajectory_samples TrajectorySamples;
+    
     f32 Time;
     f32 Duration;
     f32 WorldHeight;
     f32 LayersWorldUnitsPerPixels[2];
+    
+    // the file exists but isn't a level this version can read,
+    // saving over it would throw it away
+    bool LoadFailed;
 };
 
+bool IsInLevelMemory(level *Level, void *Pointer) {
+    return ((u8 *) Pointer >= Level->Memory) && ((u8 *) Pointer < Level->Memory + Level->MemorySize);
+}
+
+// moves the spawn infos, pointers to them have to be restored afterwards
+void GrowSpawnInfos(level *Level, u32 MinCapacity) {
+    auto Infos = &Level->SpawnInfos;
+    if (Infos->Capacity >= MinCapacity)
+        return;
+    
+    u32 NewCapacity = MAX(MinCapacity, MAX(256, (u32) Infos->Capacity * 2));
+    auto NewBase = new entity_spawn_info[NewCapacity];
+    memcpy(NewBase, Infos->Base, sizeof(entity_spawn_info) * Infos->Count);
+    
+    if (!IsInLevelMemory(Level, Infos->Base))
+        delete[] Infos->Base;
+    
+    Infos->Base = NewBase;
+    Infos->Capacity = NewCapacity;
+}
+
+void GrowPathPoints(level *Level, u32 MinCapacity) {
+    auto Points = &Level->PathPoints;
+    if (Points->Capacity >= MinCapacity)
+        return;
+    
+    u32 NewCapacity = MAX(MinCapacity, MAX(1024, (u32) Points->Capacity * 2));
+    auto NewBase = new path_point[NewCapacity];
+    memcpy(NewBase, Points->Base, sizeof(path_point) * Points->Count);
+    
+    if (!IsInLevelMemory(Level, Points->Base))
+        delete[] Points->Base;
+    
+    Points->Base = NewBase;
+    Points->Capacity = NewCapacity;
+}
+
+void GrowFollowers(spawn_lookup *Lookup, u32 MinCapacity) {
+    if (Lookup->FollowerCapacity >= MinCapacity)
+        return;
+    
+    u32 NewCapacity = MAX(MinCapacity, MAX(256, Lookup->FollowerCapacity * 2));
+    
+    auto NewFirstFollower = new u32[NewCapacity];
+    memcpy(NewFirstFollower, Lookup->FirstFollower, sizeof(u32) * Lookup->FollowerCapacity);
+    delete[] Lookup->FirstFollower;
+    
+    auto NewNextFollower = new u32[NewCapacity];
+    memcpy(NewNextFollower, Lookup->NextFollower, sizeof(u32) * Lookup->FollowerCapacity);
+    delete[] Lookup->NextFollower;
+    
+    Lookup->FirstFollower = NewFirstFollower;
+    Lookup->NextFollower = NewNextFollower;
+    Lookup->FollowerCapacity = NewCapacity;
+}
+
+// the new info gets a unique ID. may move the spawn infos, see GrowSpawnInfos
+entity_spawn_info *PushSpawnInfo(level *Level) {
+    auto Lookup = &Level->Lookup;
+    u32 Index = (u32) Level->SpawnInfos.Count;
+    
+    GrowSpawnInfos(Level, Index + 1);
+    GrowFollowers(Lookup, Index + 1);
+    
+    auto Info = Push(&Level->SpawnInfos);
+    *Info = {};
+    
+    Lookup->NextID = MAX(Lookup->NextID, (u64) 1);
+    Info->ID = Lookup->NextID++;
+    SpawnLookupInsert(Lookup, Info->ID, Index);
+    
+    Lookup->FirstFollower[Index] = 0;
+    Lookup->NextFollower[Index] = 0;
+    
+    return Info;
+}
+
+void ResolveFollowers(level *Level, u32 Index);
+
+// Leader is the index + 1 of the new leader, 0 to stop following.
+// the chains below FollowerIndex are resolved again
+void SetFollowing(level *Level, u32 FollowerIndex, u32 Leader) {
+    auto Path = &Level->SpawnInfos[FollowerIndex].Path;
+    
+    UnlinkFollower(&Level->Lookup, Path->Following, FollowerIndex);
+    LinkFollower(&Level->Lookup, Leader, FollowerIndex);
+    
+    Path->Following = Leader;
+    Path->IDFollowing = Leader ? Level->SpawnInfos[Leader - 1].ID : 0;
+    
+    ResolveFollowers(Level, FollowerIndex);
+}
+
+void ResolveFollowChains(entity_spawn_infos *Infos);
+
+// IDs are made unique and links that don't match the ID they were made for
+// are resolved again by ID. FollowRoot and FollowDelay are resolved from the
+// links afterwards, the saved ones may be for different links
+void BuildSpawnLookup(level *Level) {
+    auto Infos = &Level->SpawnInfos;
+    auto Lookup = &Level->Lookup;
+    
+    Lookup->NextID = 1;
+    for (u32 i = 0; i < Infos->Count; i++) {
+        Lookup->NextID = MAX(Lookup->NextID, (*Infos)[i].ID + 1);
+    }
+    
+    GrowFollowers(Lookup, (u32) Infos->Count);
+    
+    for (u32 i = 0; i < Infos->Count; i++) {
+        auto Info = Infos->Base + i;
+        
+        if ((Info->ID == 0) || SpawnLookupFind(Lookup, Info->ID))
+            Info->ID = Lookup->NextID++;
+        
+        SpawnLookupInsert(Lookup, Info->ID, i);
+        
+        Lookup->FirstFollower[i] = 0;
+        Lookup->NextFollower[i] = 0;
+    }
+    
+    for (u32 i = 0; i < Infos->Count; i++) {
+        if ((*Infos)[i].Blueprint.Type != Entity_Type_Fly)
+            continue;
+        
+        auto Path = &(*Infos)[i].Path;
+        
+        if ((Path->Following > Infos->Count) || (Path->Following && ((*Infos)[Path->Following - 1].ID != Path->IDFollowing)))
+            Path->Following = SpawnLookupFind(Lookup, Path->IDFollowing);
+        
+        if (Path->Following == 0)
+            Path->IDFollowing = 0;
+        
+        LinkFollower(Lookup, Path->Following, i);
+    }
+    
+    ResolveFollowChains(Infos);
+}
+
+// a range that needs to grow is handled like in PushPathPoint
+trajectory_sample *ReserveTrajectorySamples(level *Level, trajectory *Trajectory, u32 SampleCount) {
+    auto Pool = &Level->TrajectorySamples;
+    
+    if (SampleCount > Trajectory->SampleCapacity) {
+        u32 NewCapacity = MAX(SampleCount, Trajectory->SampleCapacity * 2);
+        bool IsLastRange = (Trajectory->FirstSample + Trajectory->SampleCapacity == Pool->Count);
+        u32 NewFirst = IsLastRange ? Trajectory->FirstSample : (u32) Pool->Count;
+        
+        if (NewFirst + NewCapacity > Pool->Capacity) {
+            u32 NewPoolCapacity = MAX(NewFirst + NewCapacity, MAX(4096, (u32) Pool->Capacity * 2));
+            auto NewBase = new trajectory_sample[NewPoolCapacity];
+            memcpy(NewBase, Pool->Base, sizeof(trajectory_sample) * Pool->Count);
+            delete[] Pool->Base;
+            
+            Pool->Base = NewBase;
+            Pool->Capacity = NewPoolCapacity;
+        }
+        
+        Pool->Count = NewFirst + NewCapacity;
+        Trajectory->FirstSample = NewFirst;
+        Trajectory->SampleCapacity = NewCapacity;
+    }
+    
+    Trajectory->SampleCount = SampleCount;
+    return Pool->Base + Trajectory->FirstSample;
+}
+
+path_point *GetPathPoints(level *Level, path *Path) {
+    return Level->PathPoints.Base + Path->Points.First;
+}
+
+// a full range is extended in place if it is the last one in the pool, otherwise it
+// is copied to the end of the pool. the old points are left unused until SaveLevel drops them.
+// spawned flies use the path of their spawn info, so they follow the new points right away.
+path_point *PushPathPoint(level *Level, path *Path) {
+    auto Range = &Path->Points;
+    auto Pool = &Level->PathPoints;
+    
+    if (Range->Count == Range->Capacity) {
+        u32 NewCapacity = MAX(4, Range->Capacity * 2);
+        bool IsLastRange = (Range->First + Range->Capacity == Pool->Count);
+        u32 NewFirst = IsLastRange ? Range->First : (u32) Pool->Count;
+        
+        GrowPathPoints(Level, NewFirst + NewCapacity);
+        
+        if (!IsLastRange) 
+            memcpy(Pool->Base + NewFirst, Pool->Base + Range->First, sizeof(path_point) * Range->Count);
+        
+        Pool->Count = NewFirst + NewCapacity;
+        Range->First = NewFirst;
+        Range->Capacity = NewCapacity;
+    }
+    
+    auto Point = Pool->Base + Range->First + (Range->Count++);
+    *Point = {};
+    
+    return Point;
+}
+
 // TODO: move all assets into game_state
 struct game_state {
-    entity_buffer Entities;
-    entity *Player;
+    entity_pool Entities;
+    broadphase_grid Broadphase;
+    entity_handle Player;
     f32 BulletSpawnCooldown, ChickenSpawnCooldown;
     level Level;
+    spawn_queue SpawnQueue;
     camera Camera;
     f32 WorldWidth;
     mode Mode;    
@@ -239,42 +1178,260 @@ struct game_state {
         entity_spawn_info *CurrentInfo;     
         bool DeleteButtonSelected;
     } Editor;
+    
+    f32 SimAccumulator;
+    
+    // gameplay series are reset from Seed in initGame, Effects only changes what is drawn
+    u64 Seed;
+    struct {
+        random_series Spawn;
+        random_series Fly;
+        random_series Effects;
+    } Random;
+    
+    replay Replay;
+    
+    // no window, gl or audio, see RunHeadless
+    bool IsHeadless;
+    
+    collision_stats CollisionStats;
+    
+#ifdef STRESS_TEST
+    struct {
+        f64 CollisionMilliseconds, BruteForceMilliseconds;
+        u32 CollisionCount, BruteForceCollisionCount;
+    } Stress;
+#endif
 };
 
-f32 randZeroToOne(){
-    return ((rand()  %  RAND_MAX) / (f32) RAND_MAX);
+// maps the file copy on write, changes to the memory never reach the file.
+// on windows a mapped file can't be replaced by SaveLevel, so it is read instead.
+u8 *MapFile(const char *FileName, usize *Size) {
+#if defined WIN32
+    SDL_RWops* File = SDL_RWFromFile(FileName, "rb");
+    if (File == NULL)
+        return NULL;
+    
+    *Size = (usize) SDL_RWsize(File);
+    u8 *Memory = new u8[*Size];
+    
+    if (SDL_RWread(File, Memory, *Size, 1) != 1) {
+        delete[] Memory;
+        Memory = NULL;
+    }
+    
+    SDL_RWclose(File);
+    return Memory;
+#else
+    s32 File = open(FileName, O_RDONLY);
+    if (File < 0)
+        return NULL;
+    
+    struct stat Stat;
+    void *Memory = MAP_FAILED;
+    
+    if ((fstat(File, &Stat) == 0) && (Stat.st_size > 0)) {
+        *Size = (usize) Stat.st_size;
+        Memory = mmap(NULL, *Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, File, 0);
+    }
+    
+    // the mapping stays valid after closing
+    close(File);
+    
+    if (Memory == MAP_FAILED)
+        return NULL;
+    
+    return (u8 *) Memory;
+#endif
 }
 
-f32 randMinusOneToOne(){
-    return (randZeroToOne() * 2 - 1.0f);
+void UnmapFile(u8 *Memory, usize Size) {
+#if defined WIN32
+    delete[] Memory;
+#else
+    munmap(Memory, Size);
+#endif
 }
 
-level LoadLevel(char *FileName) {
-    SDL_RWops* File = SDL_RWFromFile(FileName, "rb");
+// finds the section of Type and checks that it fits into the file
+bool GetLevelSection(u8 *Memory, usize Size, u32 Type, u32 ElementSize, u64 *Count, u64 *Offset) {
+    auto Header = (level_file_header *) Memory;
+    auto Sections = (level_file_section *) (Header + 1);
     
-    if (File == NULL) {
-        level Default = {};
-        Default.Duration = 60.0f;
+    *Count = 0;
+    *Offset = 0;
+    
+    for (u32 i = 0; i < Header->SectionCount; i++) {
+        auto Section = Sections + i;
+        if (Section->Type != Type)
+            continue;
+        
+        if ((Section->ElementSize != ElementSize) || (Section->Offset % Level_File_Section_Alignment) || 
+            (Section->Offset > Size) || (Section->Count > (Size - Section->Offset) / ElementSize))
+            return false;
+        
+        *Count = Section->Count;
+        *Offset = Section->Offset;
+        break;
+    }
+    
+    return true;
+}
+
+// the level code indexes with these fields, so a file with one out of range is rejected.
+// only flies use their path, the path of any other type is cleared
+bool CheckSpawnInfo(entity_spawn_info *Info, u64 SpawnInfoCount, u64 PathPointCount) {
+    if ((u32) Info->Blueprint.Type >= Entity_Type_Count)
+        return false;
+    
+    if (Info->Blueprint.Type != Entity_Type_Fly) {
+        Info->Path = {};
+        return true;
+    }
+    
+    auto Path = &Info->Path;
+    return (((u32) Path->Type < Path_Type_Count) && ((u32) Path->Curve < Path_Curve_Count) && 
+            (Path->Points.Count <= Path->Points.Capacity) && (Path->Points.First <= PathPointCount) && 
+            (Path->Points.Capacity <= PathPointCount - Path->Points.First) && 
+            (Path->Following <= SpawnInfoCount) && (Path->FollowRoot <= SpawnInfoCount));
+}
+
+void BakeTrajectories(level *Level);
+
+// the file is mapped and used in place, only the spawn lookup and the trajectories are built.
+// missing sections are empty, a missing file is an empty level
+// and a file that can't be read an empty level with LoadFailed set
+level LoadLevel(const char *FileName) {
+    level Default = {};
+    Default.Duration = 60.0f;
+    
+    usize Size;
+    u8 *Memory = MapFile(FileName, &Size);
+    
+    if (Memory == NULL) 
+        return (Default);
+    
+    auto Header = (level_file_header *) Memory;
+    
+    u64 SpawnInfoCount, SpawnInfoOffset;
+    u64 PathPointCount, PathPointOffset;
+    
+    bool IsValid = ((Size >= sizeof(level_file_header)) && (Header->Magic == Level_File_Magic) && (Header->Version == Level_File_Version) && 
+                    (Header->SectionCount <= (Size - sizeof(level_file_header)) / sizeof(level_file_section)));
+    
+    IsValid = IsValid && 
+        GetLevelSection(Memory, Size, Level_Section_Spawn_Infos, sizeof(entity_spawn_info), &SpawnInfoCount, &SpawnInfoOffset) && 
+        GetLevelSection(Memory, Size, Level_Section_Path_Points, sizeof(path_point), &PathPointCount, &PathPointOffset);
+    
+    for (u64 i = 0; IsValid && (i < SpawnInfoCount); i++) {
+        auto Info = (entity_spawn_info *) (Memory + SpawnInfoOffset) + i;
+        IsValid = CheckSpawnInfo(Info, SpawnInfoCount, PathPointCount);
+    }
+    
+    if (!IsValid) {
+        printf("level %s is not a level, has an unsupported version or is broken\n", FileName);
+        UnmapFile(Memory, Size);
         
+        Default.LoadFailed = true;
         return (Default);
     }
-    level Result;
     
-    size_t ReadObjectCount = SDL_RWread(File, &Result, sizeof(Result), 1);
+    level Result = {};
+    Result.Memory = Memory;
+    Result.MemorySize = Size;
+    Result.Duration = Header->Duration;
+    Result.WorldHeight = Header->WorldHeight;
+    Result.LayersWorldUnitsPerPixels[0] = Header->LayersWorldUnitsPerPixels[0];
+    Result.LayersWorldUnitsPerPixels[1] = Header->LayersWorldUnitsPerPixels[1];
+    
+    Result.SpawnInfos.Base = (entity_spawn_info *) (Memory + SpawnInfoOffset);
+    Result.SpawnInfos.Count = Result.SpawnInfos.Capacity = SpawnInfoCount;
+    Result.PathPoints.Base = (path_point *) (Memory + PathPointOffset);
+    Result.PathPoints.Count = Result.PathPoints.Capacity = PathPointCount;
+    
+    BuildSpawnLookup(&Result);
+    BakeTrajectories(&Result);
     
-    assert(ReadObjectCount == 1);
-    SDL_RWclose(File);
     return Result;
 }
 
-void SaveLevel(char *FileName, level Level) {
-    SDL_RWops* File = SDL_RWFromFile(FileName, "wb");
-    assert(File);
+u64 AlignLevelSection(u64 Offset) {
+    return (Offset + Level_File_Section_Alignment - 1) & ~((u64) Level_File_Section_Alignment - 1);
+}
+
+// writes the path points of all spawn infos without the gaps left by PushPathPoint.
+// the level is written to a temporary file first, so a mapped level stays valid
+void SaveLevel(const char *FileName, level *Level) {
+    u32 SpawnInfoCount = (u32) Level->SpawnInfos.Count;
+    u32 PathPointCount = 0;
+    
+    for (u32 i = 0; i < SpawnInfoCount; i++) {
+        auto Info = &Level->SpawnInfos[i];
+        if (Info->Blueprint.Type == Entity_Type_Fly)
+            PathPointCount += Info->Path.Points.Count;
+    }
+    
+    // the offsets are set below, once the sizes of all sections are known
+    level_file_section Sections[Level_Section_Count];
+    Sections[Level_Section_Spawn_Infos] = { Level_Section_Spawn_Infos, sizeof(entity_spawn_info), SpawnInfoCount, 0 };
+    Sections[Level_Section_Path_Points] = { Level_Section_Path_Points, sizeof(path_point), PathPointCount, 0 };
+    
+    u64 Size = sizeof(level_file_header) + sizeof(Sections);
+    for (u32 i = 0; i < Level_Section_Count; i++) {
+        Sections[i].Offset = AlignLevelSection(Size);
+        Size = Sections[i].Offset + Sections[i].ElementSize * Sections[i].Count;
+    }
+    
+    u8 *Memory = new u8[Size]();
+    
+    auto Header = (level_file_header *) Memory;
+    Header->Magic = Level_File_Magic;
+    Header->Version = Level_File_Version;
+    Header->SectionCount = Level_Section_Count;
+    Header->Duration = Level->Duration;
+    Header->WorldHeight = Level->WorldHeight;
+    Header->LayersWorldUnitsPerPixels[0] = Level->LayersWorldUnitsPerPixels[0];
+    Header->LayersWorldUnitsPerPixels[1] = Level->LayersWorldUnitsPerPixels[1];
+    memcpy(Header + 1, Sections, sizeof(Sections));
+    
+    auto Infos = (entity_spawn_info *) (Memory + Sections[Level_Section_Spawn_Infos].Offset);
+    auto Points = (path_point *) (Memory + Sections[Level_Section_Path_Points].Offset);
     
-    size_t WriteObjectCount = SDL_RWwrite(File, &Level, sizeof(Level), 1);
+    memcpy(Infos, Level->SpawnInfos.Base, sizeof(entity_spawn_info) * SpawnInfoCount);
     
+    u32 PointCount = 0;
+    for (u32 i = 0; i < SpawnInfoCount; i++) {
+        if (Infos[i].Blueprint.Type != Entity_Type_Fly)
+            continue;
+        
+        auto Range = &Infos[i].Path.Points;
+        memcpy(Points + PointCount, Level->PathPoints.Base + Range->First, sizeof(path_point) * Range->Count);
+        
+        Range->First = PointCount;
+        Range->Capacity = Range->Count;
+        PointCount += Range->Count;
+        
+        // baked again on load
+        Infos[i].Path.Trajectory = {};
+    }
+    
+    char TempFileName[1024];
+    snprintf(ARRAY_WITH_COUNT(TempFileName), "%s.tmp", FileName);
+    
+    SDL_RWops* File = SDL_RWFromFile(TempFileName, "wb");
+    assert(File);
+    
+    size_t WriteObjectCount = SDL_RWwrite(File, Memory, Size, 1);
     assert(WriteObjectCount == 1);
+    
     SDL_RWclose(File);
+    delete[] Memory;
+    
+#if defined WIN32
+    MoveFileExA(TempFileName, FileName, MOVEFILE_REPLACE_EXISTING);
+#else
+    rename(TempFileName, FileName);
+#endif
 }
 
 struct config {
@@ -283,7 +1440,7 @@ struct config {
     
 };
 
-config LoadConfig(char *FileName) {
+config LoadConfig(const char *FileName) {
     SDL_RWops* File = SDL_RWFromFile(FileName, "rb");
     
     if (File == NULL)
@@ -300,7 +1457,7 @@ config LoadConfig(char *FileName) {
     return Result;
 }
 
-void SaveConfig(char *FileName, SDL_Window *Window) {
+void SaveConfig(const char *FileName, SDL_Window *Window) {
     SDL_RWops* File = SDL_RWFromFile(FileName, "wb");
     assert(File);
     
@@ -325,145 +1482,331 @@ f32 LookAtRotation(vec2 Eye, vec2 Target) {
     return Alpha;
 }
 
-entity MakeChicken(vec2 WorldPositionOffset) {
+entity MakeChicken(random_series *Random, vec2 WorldPositionOffset, entity_cold *Cold) {
     entity Result = {};
     
     Result.XForm.Rotation = 0.0f;
     Result.XForm.Scale = 0.09f;
     Result.CollisionRadius = Result.XForm.Scale * 0.65;
-    Result.MaxHp = 10;
-    Result.Hp = Result.MaxHp;
     Result.Type = Entity_Type_Fly;
-    Result.CollisionTypeMask = FLAG(Entity_Type_Player) | FLAG(Entity_Type_Bullet); 
     Result.fly.FireCountdown = 0.25f;
     Result.fly.Velocity = vec2{1.0f, 0.1f};    
-    Result.XForm.Pos = vec2{-0.5f, randZeroToOne()} + WorldPositionOffset;   
+    Result.XForm.Pos = vec2{-0.5f, randZeroToOne(Random)} + WorldPositionOffset;   
     Result.RelativeDrawCenter = vec2 {0.5f, 0.44f};
-    Result.BlinkDuration = 0.1f;
     
+    *Cold = {};
+    Cold->MaxHp = 10;
+    Cold->Hp = Cold->MaxHp;
+    Cold->BlinkDuration = 0.1f;
+    
+    return Result;
+}
+
+f32 lerpAngle(f32 A, f32 B, f32 T) {
+    f32 Delta = fmodf(B - A, 2 * PI);
+    
+    if (Delta > PI)
+        Delta -= 2 * PI;
+    else if (Delta < -PI)
+        Delta += 2 * PI;
+    
+    return A + Delta * T;
+}
+
+// the next step moves the entity away from its current XForm. done for every entity after
+// the collisions of a step and for new entities when they are spawned, so their first step is swept too
+void SnapshotXForm(entity *Entity) {
+    Entity->PrevXForm = Entity->XForm;
+    Entity->HasPrevXForm = true;
+}
+
+// Alpha is the fraction of the next simulation step that has already passed
+transform InterpolatedXForm(entity *Entity, f32 Alpha) {
+    if (!Entity->HasPrevXForm)
+        return Entity->XForm;
+    
+    transform Result;
+    Result.Pos.X    = lerp(Entity->PrevXForm.Pos.X, Entity->XForm.Pos.X, Alpha);
+    Result.Pos.Y    = lerp(Entity->PrevXForm.Pos.Y, Entity->XForm.Pos.Y, Alpha);
+    Result.Rotation = lerpAngle(Entity->PrevXForm.Rotation, Entity->XForm.Rotation, Alpha);
+    Result.Scale    = lerp(Entity->PrevXForm.Scale, Entity->XForm.Scale, Alpha);
     
     return Result;
 }
 
-void DrawEntity(game_state *State, entity *Entity, color Color = White_Color){
+// archetype kernels, one specialization per entity_type. only UpdateEntity has
+// a default, for types that don't need an update.
+// the generic loops and the registration are in Entity_Archetypes.
+
 #ifdef DEBUG_UI
-    transform collisionTransform = Entity->XForm;
+void DrawEntityCollision(game_state *State, entity *Entity, transform XForm) {
+    transform collisionTransform = XForm;
     collisionTransform.Scale = 2 * Entity->CollisionRadius;
     DrawCircle(State->Camera, collisionTransform, color{0.3f, 0.3f, 0.0f, 1.0f}, false);
     DrawLine(State->Camera, collisionTransform, vec2{0, 0}, vec2{1, 0}, color{1.0f, 0.0f, 0.0f, 1.0f});
     DrawLine(State->Camera, collisionTransform, vec2{0, 0}, vec2{0, 1}, color{0.0f, 1.0f, 0.0f, 1.0f});
-#endif    
+}
+#else
+void DrawEntityCollision(game_state *, entity *, transform) {
+}
+#endif // DEBUG_UI
+
+color BlinkColor(color Color, entity_cold *Cold, f32 Time) {
+    f32 BlinkTime = Cold->BlinkEndTime - Time;
+    if (BlinkTime <= 0)
+        return Color;
     
-    switch (Entity->Type) {
-        
-        case Entity_Type_Player: {
-            DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.PlayerTexture, Color, Entity->RelativeDrawCenter);
-        } break; 
-        
-        case Entity_Type_Bullet: {
-            if (Entity->bullet.Damage == 1) {
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BulletTexture, Color, Entity->RelativeDrawCenter);
-            } 
-            else if (Entity->bullet.Damage == 2){
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BulletPoweredUpTexture, Color, Entity->RelativeDrawCenter);  
-            }
-            else {
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BulletMaxPoweredUpTexture, Color, Entity->RelativeDrawCenter);
-            }
-        } break;
+    return lerp(Color, color{0.0f, 0.0f, 0.2f, 1.0f}, BlinkTime / Cold->BlinkDuration); 
+}
+
+// no default, every entity_type has to say how it is drawn
+template <entity_type Type>
+void DrawEntity(game_state *, entity *, entity_cold *, transform, color) {
+    static_assert(Type == Entity_Type_Count, "missing DrawEntity specialization for this entity_type");
+}
+
+template <>
+void DrawEntity<Entity_Type_Player>(game_state *State, entity *Entity, entity_cold *, transform XForm, color Color) {
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.PlayerTexture, Color, Entity->RelativeDrawCenter);
+}
+
+template <>
+void DrawEntity<Entity_Type_Bullet>(game_state *State, entity *Entity, entity_cold *, transform XForm, color Color) {
+    if (Entity->bullet.Damage == 1) {
+        DrawTexturedQuad(State->Camera, XForm, State->Assets.BulletTexture, Color, Entity->RelativeDrawCenter);
+    } 
+    else if (Entity->bullet.Damage == 2){
+        DrawTexturedQuad(State->Camera, XForm, State->Assets.BulletPoweredUpTexture, Color, Entity->RelativeDrawCenter);  
+    }
+    else {
+        DrawTexturedQuad(State->Camera, XForm, State->Assets.BulletMaxPoweredUpTexture, Color, Entity->RelativeDrawCenter);
+    }
+}
+
+template <>
+void DrawEntity<Entity_Type_Enemy_Bullet>(game_state *State, entity *Entity, entity_cold *, transform XForm, color Color) {
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.BulletMaxPoweredUpTexture, Color, Entity->RelativeDrawCenter);
+}
+
+template <>
+void DrawEntity<Entity_Type_Boss>(game_state *State, entity *Entity, entity_cold *Cold, transform XForm, color Color) {
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.BossTexture, BlinkColor(Color, Cold, State->Level.Time), Entity->RelativeDrawCenter);          
+}
+
+template <>
+void DrawEntity<Entity_Type_Fly>(game_state *State, entity *Entity, entity_cold *Cold, transform XForm, color Color) {
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.FlyTexture, BlinkColor(Color, Cold, State->Level.Time), Entity->RelativeDrawCenter);          
+}
+
+template <>
+void DrawEntity<Entity_Type_Bomb>(game_state *State, entity *Entity, entity_cold *, transform XForm, color) {
+    // the simulation keeps the size in world units, so it doesn't depend on the loaded texture
+    XForm.Scale /= State->Assets.BombTexture.Height * Default_World_Units_Per_Texel;
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.BombTexture, color{randZeroToOne(&State->Random.Effects), randZeroToOne(&State->Random.Effects), randZeroToOne(&State->Random.Effects), 1.0f}, Entity->RelativeDrawCenter);    
+}
+
+template <>
+void DrawEntity<Entity_Type_Powerup>(game_state *State, entity *Entity, entity_cold *, transform XForm, color Color) {
+    DrawTexturedQuad(State->Camera, XForm, State->Assets.PowerupTexture, Color, Entity->RelativeDrawCenter);
+}
+
+bool IsFollowing(entity_spawn_info *Info) {
+    return ((Info->Blueprint.Type == Entity_Type_Fly) && (Info->Path.Type == Path_Type_Follow) && (Info->Path.Following != 0));
+}
+
+// a follower is at its leaders position TransitionTime later, so a whole chain
+// is the path at its end with the summed delays. we walk each chain once up to
+// an already resolved leader and then resolve it back down, leaders before followers,
+// so resolving all infos is O(n) and every fly evaluates a single path per frame.
+// followers in a cycle get no FollowRoot and stay where they are.
+// the results are saved with the level, but BuildSpawnLookup resolves them again on load.
+void ResolveFollowChains(entity_spawn_infos *Infos) {
+    enum {
+        Unresolved,
+        OnChain,
+        Resolved,
+    };
+    
+    auto Scratch = BeginTemporaryMemory(&Global_Frame_Arena);
+    u8 *States = PUSH_ARRAY(&Global_Frame_Arena, u8, Infos->Count);
+    u32 *Chain = PUSH_ARRAY(&Global_Frame_Arena, u32, Infos->Count);
+    memset(States, Unresolved, Infos->Count);
+    
+    for (u32 i = 0; i < Infos->Count; i++) {
+        if (Infos->Base[i].Blueprint.Type == Entity_Type_Fly)
+            Infos->Base[i].Path.FollowRoot = 0;
+    }
+    
+    for (u32 i = 0; i < Infos->Count; i++) {
+        if (States[i] == Resolved)
+            continue;
         
-        case Entity_Type_Boss: {
-            if (Entity->BlinkTime <= 0) {
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BossTexture, Color, Entity->RelativeDrawCenter); 
-            } 
-            else {
-                color BlinkColor = lerp(Color, color{0.0f, 0.0f, 0.2f, 1.0f}, Entity->BlinkTime / Entity->BlinkDuration); 
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BossTexture, BlinkColor, Entity->RelativeDrawCenter);          
-            }   
-        } break;
+        // walk up the leaders until we find a resolved one or the root
+        u32 ChainCount = 0;
+        u32 Current = i;
         
-        case Entity_Type_Fly: {
-            if (Entity->BlinkTime <= 0) {
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.FlyTexture, Color, Entity->RelativeDrawCenter); 
-            } 
-            else {
-                color BlinkColor = lerp(Color, color{0.0f, 0.0f, 0.2f, 1.0f}, Entity->BlinkTime / Entity->BlinkDuration); 
-                DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.FlyTexture, BlinkColor, Entity->RelativeDrawCenter);          
-            }   
-        } break;
+        while ((States[Current] == Unresolved) && IsFollowing(Infos->Base + Current)) {
+            States[Current] = OnChain;
+            Chain[ChainCount++] = Current;
+            Current = Infos->Base[Current].Path.Following - 1;
+            assert(Current < Infos->Count);
+        }
         
-        case Entity_Type_Bomb: {
-            DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.BombTexture, color{randZeroToOne(), randZeroToOne(), randZeroToOne(), 1.0f}, Entity->RelativeDrawCenter);    
-        } break;
+        u32 Root = 0;
+        f32 Delay = 0.0f;
         
-        case Entity_Type_Powerup: {
-            DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.PowerupTexture, Color, Entity->RelativeDrawCenter);
-        } break;
+        if (States[Current] == OnChain) {
+            // cycle, Root stays 0
+        }
+        else if (IsFollowing(Infos->Base + Current)) {
+            auto Leader = &Infos->Base[Current].Path;
+            Root = Leader->FollowRoot;
+            Delay = Leader->FollowDelay;
+        }
+        else {
+            Root = Current + 1;
+            States[Current] = Resolved;
+        }
         
-        default: {
-            DrawTexturedQuad(State->Camera, Entity->XForm, State->Assets.FlyTexture, Color, Entity->RelativeDrawCenter);     
+        while (ChainCount > 0) {
+            auto Path = &Infos->Base[Chain[--ChainCount]].Path;
+            
+            if (Root)
+                Delay += Path->TransitionTime;
+            
+            Path->FollowRoot = Root;
+            Path->FollowDelay = Delay;
+            States[Chain[ChainCount]] = Resolved;
         }
-    }    
-}
-
-void DrawAllEntities(game_state *State) {
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_ALPHA_TEST);
-    glAlphaFunc(GL_GEQUAL, 0.1f);    
-    
-    for (u32 i = 0; i < State->Entities.Count; i++) {
-        auto Entity = State->Entities.Base + i;
-        DrawEntity(State, Entity);
     }
     
-    glDisable(GL_BLEND);
-    glDisable(GL_TEXTURE_2D);
+    EndTemporaryMemory(Scratch);
 }
 
-void RestoreFollowingPointer(entity_spawn_infos *Infos) {
-    for (u32 i = 0; i < Infos->Count; i++) {
-        if ((*Infos)[i].Blueprint.Type != Entity_Type_Fly)
-            continue;
+// sets FollowRoot and FollowDelay of the followers of Index and theirs from Root and Delay.
+// returns false if Index is one of them, then Index follows its own followers
+bool PropagateFollowRoot(level *Level, u32 Index, u32 Root, f32 Delay) {
+    auto Infos = &Level->SpawnInfos;
+    auto Lookup = &Level->Lookup;
+    bool IsCycle = false;
+    
+    // the followers form a tree below Index, unless it is part of a cycle
+    auto Scratch = BeginTemporaryMemory(&Global_Frame_Arena);
+    u32 *Stack = PUSH_ARRAY(&Global_Frame_Arena, u32, Infos->Count);
+    u32 StackCount = 0;
+    Stack[StackCount++] = Index;
+    
+    while (StackCount > 0) {
+        u32 LeaderIndex = Stack[--StackCount];
+        auto Leader = &Infos->Base[LeaderIndex].Path;
         
-        auto IDFollowing = (*Infos)[i].Blueprint.fly.Path.IDFollowing;
-        if (IDFollowing == 0)
-            continue;
+        u32 LeaderRoot = Root;
+        f32 LeaderDelay = Delay;
         
-        for (u32 j = 0; i < Infos->Count; j++) {
-            if (IDFollowing = (*Infos)[j].ID) {
-                (*Infos)[i].Blueprint.fly.Path.Following = &(*Infos)[j];
-                break;
+        if (LeaderIndex != Index) {
+            LeaderRoot = Leader->FollowRoot;
+            LeaderDelay = Leader->FollowDelay;
+        }
+        
+        for (u32 Follower = Lookup->FirstFollower[LeaderIndex]; Follower != 0; Follower = Lookup->NextFollower[Follower - 1]) {
+            auto FollowerInfo = Infos->Base + Follower - 1;
+            
+            if (!IsFollowing(FollowerInfo))
+                continue;
+            
+            if (Follower - 1 == Index) {
+                IsCycle = true;
+                continue;
             }
+            
+            auto Path = &FollowerInfo->Path;
+            Path->FollowRoot = LeaderRoot;
+            Path->FollowDelay = LeaderRoot ? LeaderDelay + Path->TransitionTime : 0.0f;
+            
+            Stack[StackCount++] = Follower - 1;
         }
     }
+    
+    EndTemporaryMemory(Scratch);
+    return !IsCycle;
 }
 
-void initGame (game_state *State) {
-    State->Entities.Count = 0;
-    for (u32 i = 0; i < State->Level.SpawnInfos.Count; i++) {
-        State->Level.SpawnInfos[i].WasNotSpawned = true;
+// like ResolveFollowChains, but only for Index, its followers and theirs.
+// has to run after anything that changes how Index follows or is followed:
+// SetFollowing, its TransitionTime, its path type or its blueprint type
+void ResolveFollowers(level *Level, u32 Index) {
+    auto Infos = &Level->SpawnInfos;
+    auto Info = Infos->Base + Index;
+    auto Path = &Info->Path;
+    
+    if (!IsFollowing(Info)) {
+        if (Info->Blueprint.Type == Entity_Type_Fly) {
+            Path->FollowRoot = 0;
+            Path->FollowDelay = 0.0f;
+        }
+        
+        // leads its own chain, it can't be on a cycle
+        PropagateFollowRoot(Level, Index, Index + 1, 0.0f);
+        return;
+    }
+    
+    auto Leader = Infos->Base + Path->Following - 1;
+    
+    Path->FollowRoot = Path->Following;
+    Path->FollowDelay = 0.0f;
+    
+    if (IsFollowing(Leader)) {
+        Path->FollowRoot = Leader->Path.FollowRoot;
+        Path->FollowDelay = Leader->Path.FollowDelay;
+    }
+    
+    if (Path->FollowRoot)
+        Path->FollowDelay += Path->TransitionTime;
+    else
+        Path->FollowDelay = 0.0f;
+    
+    // following one of its own followers closes a cycle, nobody on it or below it has a root
+    if (!PropagateFollowRoot(Level, Index, Path->FollowRoot, Path->FollowDelay)) {
+        Path->FollowRoot = 0;
+        Path->FollowDelay = 0.0f;
+        PropagateFollowRoot(Level, Index, 0, 0.0f);
     }
+}
+
+void initGame (game_state *State) {
+    Clear(&State->Entities);
+    SpawnQueueBuild(&State->SpawnQueue, &State->Level.SpawnInfos);
     
     State->Level.Time = 0.0f;
     State->Camera.WorldPosition = { 0.0f, WorldCameraHeight * 0.5f };
-    
-    State->Player = NextEntity(&State->Entities); 
-    State->Player->XForm = TRANSFORM_IDENTITY;
-    State->Player->XForm.Scale = 0.1f;
-    State->Player->CollisionRadius = State->Player->XForm.Scale * 0.5;
-    State->Player->MaxHp = 1;
-    State->Player->Hp = State->Player->MaxHp;
-    State->Player->player.Power = 0;
-    State->Player->player.Bombs = 3;
-    State->Player->Type = Entity_Type_Player;
-    State->Player->CollisionTypeMask = FLAG(Entity_Type_Boss) | FLAG(Entity_Type_Bullet) | FLAG(Entity_Type_Fly) | FLAG(Entity_Type_Powerup);
-    State->Player->RelativeDrawCenter = vec2 {0.5f, 0.4f};  
+    State->BulletSpawnCooldown = 0.0f;
+    State->SimAccumulator = 0.0f;
+    
+    State->Random.Spawn = MakeRandomSeries(State->Seed, 1);
+    State->Random.Fly   = MakeRandomSeries(State->Seed, 2);
+    
+    entity_cold *PlayerCold;
+    auto Player = NextEntity(&State->Entities, Entity_Type_Player, &State->Player, &PlayerCold); 
+    Player->XForm = TRANSFORM_IDENTITY;
+    Player->XForm.Scale = 0.1f;
+    Player->CollisionRadius = Player->XForm.Scale * 0.5;
+    PlayerCold->MaxHp = 1;
+    PlayerCold->Hp = PlayerCold->MaxHp;
+    Player->player.Power = 0;
+    Player->player.Bombs = 3;
+    Player->RelativeDrawCenter = vec2 {0.5f, 0.4f};  
+    SnapshotXForm(Player);
 };
 
+entity *GetPlayer(game_state *State) {
+    auto Player = GetEntity(&State->Entities, State->Player);
+    assert(Player);
+    
+    return Player;
+}
+
 void UpdateTitle(game_state *State, ui_context *Ui, ui_control *UiControl, font *Font, f32 DeltaSeconds, input GameInput, bool *DoContinue){
-    char *Items[] = {
+    const char *Items[] = {
         "New game",
         "Load Game",
         "Settings",                 
@@ -545,7 +1888,7 @@ void UpdateSettings(game_state *State, ui_context *Ui, ui_control *UiControl, fo
     rect VolBar = MakeRect(MinVolPos, VolPosY - 15, MaxVolPos, VolPosY + 15);
     
     f32 CurrentVolPos = (MaxVolPos - MinVolPos) * (Mix_VolumeMusic(-1) / (f32)MIX_MAX_VOLUME) + MinVolPos;
-    //vec2 Delta;
+    vec2 Delta;
     
     UiRectangle(Ui, VolBar, Green_Color, false);
     UiRectangle(Ui, VolBar.Left, VolBar.Bottom, CurrentVolPos - MinVolPos, VolBar.Top - VolBar.Bottom, Green_Color);
@@ -556,7 +1899,7 @@ void UpdateSettings(game_state *State, ui_context *Ui, ui_control *UiControl, fo
     // MIX_MIN_VOLUME == 0
     f32 DiffToNextVolPos = (MaxVolPos - MinVolPos) / (f32)(MIX_MAX_VOLUME - 0 + 1);
     
-    if (UiDragable(UiControl, UI_ID0, MakeRect(CurrentVolPos - 10, VolPosY - 15, CurrentVolPos + 10, VolPosY + 15), &vec2{})) {
+    if (UiDragable(UiControl, UI_ID0, MakeRect(CurrentVolPos - 10, VolPosY - 15, CurrentVolPos + 10, VolPosY + 15), &Delta)) {
         Mix_VolumeMusic((GameInput.MousePos.X - MinVolPos) / DiffToNextVolPos + 0 - 1);
     }
     
@@ -642,178 +1985,666 @@ void UpdateSettings(game_state *State, ui_context *Ui, ui_control *UiControl, fo
         UiTexturedRectangle(Ui, State->Assets.IdleButtonTexture, Rect.Left, Rect.Bottom, Rect.Right - Rect.Left, Rect.Top - Rect.Bottom, 0, 0, State->Assets.IdleButtonTexture.Width, State->Assets.IdleButtonTexture.Height, White_Color);
     
     
-    Cursor.CurrentX -= Offset;
-    Cursor.CurrentY += CursorYOffset;
-    UiWrite(&Cursor, "%s\n", "Save");
-    Cursor.CurrentY -= 20 * Cursor.Scale + 2 * Border + CursorYOffset;
+    Cursor.CurrentX -= Offset;
+    Cursor.CurrentY += CursorYOffset;
+    UiWrite(&Cursor, "%s\n", "Save");
+    Cursor.CurrentY -= 20 * Cursor.Scale + 2 * Border + CursorYOffset;
+}
+
+vec2 lerp(vec2 A, vec2 B, f32 T) {
+    return vec2{ lerp(A.X, B.X, T), lerp(A.Y, B.Y, T) };
+}
+
+// curved segments get a table of their length at Path_Arc_Length_Steps even steps
+// of the curve parameter. the time between two points then maps to an even speed
+// along the curve, instead of slowing down where the control points bunch up.
+const u32 Path_Arc_Length_Steps = 16;
+
+// position on a path for PathPositionAt. only valid for one path as long as
+// its points don't change
+struct path_cursor {
+    u32 SegmentIndex;
+    u32 ArcLengthsSegmentIndex; // index + 1 of the segment ArcLengths belongs to, 0 if none
+    f32 ArcLengths[Path_Arc_Length_Steps + 1]; // from 0 to 1
+};
+
+// number of points from the start of one segment to the next
+u32 PathSegmentStep(path *Path) {
+    if (Path->Curve == Path_Curve_Bezier)
+        return 3;
+    
+    return 1;
+}
+
+// position on the segment starting at point First, T goes from 0 to 1 along the curve parameter
+vec2 PathSegmentPosition(path *Path, path_point *Points, u32 First, f32 T) {
+    u32 Count = Path->Points.Count;
+    
+    switch (Path->Curve) {
+        case Path_Curve_Catmull_Rom: {
+            // the missing neighbours at both ends are mirrored
+            vec2 P1 = Points[First].Position;
+            vec2 P2 = Points[First + 1].Position;
+            vec2 P0 = (First > 0) ? Points[First - 1].Position : P1 * 2.0f - P2;
+            vec2 P3 = (First + 2 < Count) ? Points[First + 2].Position : P2 * 2.0f - P1;
+            
+            f32 T2 = T * T;
+            f32 T3 = T2 * T;
+            
+            return (P1 * 2.0f + 
+                    (P2 - P0) * T + 
+                    (P0 * 2.0f - P1 * 5.0f + P2 * 4.0f - P3) * T2 + 
+                    (P1 * 3.0f - P0 - P2 * 3.0f + P3) * T3) * 0.5f;
+        } 
+        
+        case Path_Curve_Bezier: {
+            // de casteljau, the last segment can have less than 2 control points
+            vec2 Controls[4];
+            u32 ControlCount = MIN(Count - First, 4u);
+            
+            for (u32 i = 0; i < ControlCount; i++)
+                Controls[i] = Points[First + i].Position;
+            
+            for (u32 Degree = ControlCount - 1; Degree > 0; Degree--) {
+                for (u32 i = 0; i < Degree; i++)
+                    Controls[i] = lerp(Controls[i], Controls[i + 1], T);
+            }
+            
+            return Controls[0];
+        }
+        
+        default: {
+            return lerp(Points[First].Position, Points[First + 1].Position, T);
+        }
+    }
+}
+
+void BuildArcLengths(path_cursor *Cursor, path *Path, path_point *Points, u32 First) {
+    f32 *Lengths = Cursor->ArcLengths;
+    Lengths[0] = 0;
+    
+    vec2 Previous = PathSegmentPosition(Path, Points, First, 0.0f);
+    
+    for (u32 i = 1; i <= Path_Arc_Length_Steps; i++) {
+        vec2 Position = PathSegmentPosition(Path, Points, First, (f32) i / Path_Arc_Length_Steps);
+        Lengths[i] = Lengths[i - 1] + length(Position - Previous);
+        Previous = Position;
+    }
+    
+    // a segment without length keeps the curve parameter
+    f32 TotalLength = Lengths[Path_Arc_Length_Steps];
+    
+    for (u32 i = 1; i <= Path_Arc_Length_Steps; i++) {
+        if (TotalLength > 0)
+            Lengths[i] /= TotalLength;
+        else
+            Lengths[i] = (f32) i / Path_Arc_Length_Steps;
+    }
+    
+    Cursor->ArcLengthsSegmentIndex = First + 1;
+}
+
+// curve parameter of the point that is Fraction of the segment length along the curve
+f32 ArcLengthToCurveParameter(path_cursor *Cursor, f32 Fraction) {
+    f32 *Lengths = Cursor->ArcLengths;
+    
+    u32 Low = 0;
+    u32 High = Path_Arc_Length_Steps;
+    
+    while (High - Low > 1) {
+        u32 Middle = (Low + High) / 2;
+        
+        if (Lengths[Middle] <= Fraction)
+            Low = Middle;
+        else
+            High = Middle;
+    }
+    
+    f32 StepLength = Lengths[Low + 1] - Lengths[Low];
+    f32 Alpha = 0.0f;
+    if (StepLength > 0)
+        Alpha = (Fraction - Lengths[Low]) / StepLength;
+    
+    return (Low + Alpha) / Path_Arc_Length_Steps;
+}
+
+// position at Time along the points, clamped to the first and last point.
+// Cursor->SegmentIndex is only a hint where to start searching, time mostly moves
+// forward so this is usually no or one step
+vec2 PathPositionAt(level *Level, path *Path, f32 Time, path_cursor *Cursor) {
+    auto Points = GetPathPoints(Level, Path);
+    u32 Count = Path->Points.Count;
+    assert(Count >= 2);
+    
+    if (Time < Points[0].Time)
+        return Points[0].Position;
+    
+    if (Time >= Points[Count - 1].Time)
+        return Points[Count - 1].Position;
+    
+    u32 Step = PathSegmentStep(Path);
+    u32 LastSegmentIndex = ((Count - 2) / Step) * Step;
+    u32 i = MIN(Cursor->SegmentIndex, LastSegmentIndex);
+    i -= i % Step;
+    
+    while ((i < LastSegmentIndex) && (Time >= Points[i + Step].Time))
+        i += Step;
+    
+    while ((i > 0) && (Time < Points[i].Time))
+        i -= Step;
+    
+    Cursor->SegmentIndex = i;
+    
+    auto From = Points + i;
+    auto To = Points + MIN(i + Step, Count - 1);
+    assert((From->Time <= Time) && (Time < To->Time));
+    
+    f32 Alpha = (Time - From->Time) / (To->Time - From->Time);
+    
+    if (Path->Curve == Path_Curve_Linear)
+        return lerp(From->Position, To->Position, Alpha);
+    
+    if (Cursor->ArcLengthsSegmentIndex != i + 1)
+        BuildArcLengths(Cursor, Path, Points, i);
+    
+    return PathSegmentPosition(Path, Points, i, ArcLengthToCurveParameter(Cursor, Alpha));
+}
+
+// position of a stop, loop or reverse path, Time is relative to the spawn time.
+// returns Default if the path has no points
+vec2 FlyPathPosition(level *Level, path *Path, f32 Time, path_cursor *Cursor, vec2 Default) {
+    assert(Path->Type != Path_Type_Follow);
+    
+    auto Points = GetPathPoints(Level, Path);
+    
+    if (Path->Points.Count == 0) 
+        return Default; 
+    else if (Path->Points.Count == 1)
+        return Points[0].Position;
+    
+    auto FirstPoint = Points;
+    auto LastPoint = Points + Path->Points.Count - 1;
+    
+    if (Time >= LastPoint->Time) {
+        //fly after last point, map Time back onto the path
+        switch (Path->Type) {
+            case Path_Type_Stop: {
+            } break;
+            
+            case Path_Type_Loop: {
+                // a round starts at time 0 (including the wait for the first point)
+                // and ends after going back from the last to the first point
+                f32 CompleteRound = LastPoint->Time + Path->TransitionTime;
+                if (CompleteRound <= 0)
+                    break;
+                
+                Time = fmodf(Time, CompleteRound);
+                
+                if (Time >= LastPoint->Time)
+                    return lerp(LastPoint->Position, FirstPoint->Position, (Time - LastPoint->Time) / Path->TransitionTime);
+            } break;
+            
+            case Path_Type_Reverse: {
+                // ping pong between time 0 and the last point
+                if (LastPoint->Time <= 0)
+                    break;
+                
+                f32 Phase = fmodf(Time - LastPoint->Time, 2 * LastPoint->Time);
+                
+                if (Phase < LastPoint->Time)
+                    Time = LastPoint->Time - Phase; // on the way back
+                else
+                    Time = Phase - LastPoint->Time;
+            } break;
+            
+            default: {
+                u32 InvalidPathType = 0;
+                assert(InvalidPathType);
+            }
+        }
+    }
+    
+    return PathPositionAt(Level, Path, Time, Cursor);
+}
+
+// samples FlyPathPosition over one round of the path, so the position at any
+// time is a table lookup, see TrajectoryPosition.
+// needs to run again whenever the path of the spawn info changes
+void BakeTrajectory(level *Level, path *Path) {
+    auto Trajectory = &Path->Trajectory;
+    
+    if ((Path->Type == Path_Type_Follow) || (Path->Points.Count == 0)) {
+        Trajectory->SampleCount = 0;
+        return;
+    }
+    
+    auto Points = GetPathPoints(Level, Path);
+    f32 LastTime = Points[Path->Points.Count - 1].Time;
+    
+    // same special cases as FlyPathPosition
+    Trajectory->Mode = Trajectory_Mode_Clamp;
+    Trajectory->Period = MAX(LastTime, 0.0f);
+    
+    if ((Path->Type == Path_Type_Loop) && (LastTime + Path->TransitionTime > 0)) {
+        Trajectory->Mode = Trajectory_Mode_Wrap;
+        Trajectory->Period = LastTime + Path->TransitionTime;
+    }
+    else if ((Path->Type == Path_Type_Reverse) && (LastTime > 0)) {
+        Trajectory->Mode = Trajectory_Mode_Mirror;
+    }
+    
+    // one more sample past the end, so the last one can always be interpolated
+    u32 SampleCount = (u32) ceilf(Trajectory->Period * Trajectory_Samples_Per_Second) + 2;
+    
+    // bounds of the samples, catmull rom curves can leave the bounds of their points
+    vec2 Min = { f32_max, f32_max };
+    vec2 Max = { f32_min, f32_min };
+    
+    path_cursor Cursor = {};
+    for (u32 i = 0; i < SampleCount; i++) {
+        vec2 Position = FlyPathPosition(Level, Path, i / Trajectory_Samples_Per_Second, &Cursor, {});
+        
+        Min.X = MIN(Min.X, Position.X);
+        Min.Y = MIN(Min.Y, Position.Y);
+        Max.X = MAX(Max.X, Position.X);
+        Max.Y = MAX(Max.Y, Position.Y);
+    }
+    
+    Trajectory->Min = Min;
+    Trajectory->Scale = (Max - Min) * (1.0f / 65535.0f);
+    
+    vec2 InverseScale = {};
+    if (Max.X > Min.X)
+        InverseScale.X = 65535.0f / (Max.X - Min.X);
+    if (Max.Y > Min.Y)
+        InverseScale.Y = 65535.0f / (Max.Y - Min.Y);
+    
+    auto Samples = ReserveTrajectorySamples(Level, Trajectory, SampleCount);
+    
+    Cursor = {};
+    for (u32 i = 0; i < SampleCount; i++) {
+        vec2 Position = FlyPathPosition(Level, Path, i / Trajectory_Samples_Per_Second, &Cursor, {});
+        
+        Samples[i].X = (u16) CLAMP((Position.X - Min.X) * InverseScale.X + 0.5f, 0.0f, 65535.0f);
+        Samples[i].Y = (u16) CLAMP((Position.Y - Min.Y) * InverseScale.Y + 0.5f, 0.0f, 65535.0f);
+    }
+}
+
+void BakeTrajectories(level *Level) {
+    for (u32 i = 0; i < Level->SpawnInfos.Count; i++) {
+        auto Info = &Level->SpawnInfos[i];
+        
+        if (Info->Blueprint.Type == Entity_Type_Fly)
+            BakeTrajectory(Level, &Info->Path);
+    }
+}
+
+// Time is relative to the spawn time, returns Default if there are no samples
+vec2 TrajectoryPosition(level *Level, trajectory *Trajectory, f32 Time, vec2 Default) {
+    if (Trajectory->SampleCount == 0)
+        return Default;
+    
+    if (Time <= 0) {
+        Time = 0;
+    }
+    else {
+        switch (Trajectory->Mode) {
+            case Trajectory_Mode_Clamp: {
+                Time = MIN(Time, Trajectory->Period);
+            } break;
+            
+            case Trajectory_Mode_Wrap: {
+                Time = fmodf(Time, Trajectory->Period);
+            } break;
+            
+            case Trajectory_Mode_Mirror: {
+                Time = fmodf(Time, 2 * Trajectory->Period);
+                if (Time > Trajectory->Period)
+                    Time = 2 * Trajectory->Period - Time;
+            } break;
+        }
+    }
+    
+    f32 SampleTime = Time * Trajectory_Samples_Per_Second;
+    u32 Index = MIN((u32) SampleTime, Trajectory->SampleCount - 2);
+    f32 Alpha = MIN(SampleTime - Index, 1.0f);
+    
+    auto Samples = Level->TrajectorySamples.Base + Trajectory->FirstSample + Index;
+    vec2 From = { (f32) Samples[0].X, (f32) Samples[0].Y };
+    vec2 To   = { (f32) Samples[1].X, (f32) Samples[1].Y };
+    
+    return Trajectory->Min + lerp(From, To, Alpha) * Trajectory->Scale;
+}
+
+// position of a fly spawned from the spawn info at InfoIndex, Default if its path has no points
+vec2 FlyPosition(level *Level, u32 InfoIndex, f32 LevelTime, vec2 Default) {
+    auto Info = &Level->SpawnInfos[InfoIndex];
+    assert(Info->Blueprint.Type == Entity_Type_Fly);
+    
+    auto Path = &Info->Path;
+    
+    if (Path->Type != Path_Type_Follow)
+        return TrajectoryPosition(Level, &Path->Trajectory, LevelTime - Info->SpawnTime, Default);
+    
+    // followers evaluate the path at the end of their chain directly, see ResolveFollowChains
+    if (Path->FollowRoot == 0)
+        return Default;
+    
+    auto Root = &Level->SpawnInfos[Path->FollowRoot - 1];
+    
+    if ((Root->Blueprint.Type != Entity_Type_Fly) || (Root->Path.Type == Path_Type_Follow))
+        return Root->Blueprint.XForm.Pos;
+    
+    return TrajectoryPosition(Level, &Root->Path.Trajectory, LevelTime + Path->FollowDelay - Root->SpawnTime, Root->Blueprint.XForm.Pos);
+}
+
+// flies that weren't spawned from a spawn info don't move
+void UpdateFlyPosition (level *Level, entity *Entity, f32 LevelTime) {
+    assert(Entity->Type == Entity_Type_Fly);
+    
+    if (Entity->fly.SpawnInfo != 0)
+        Entity->XForm.Pos = FlyPosition(Level, Entity->fly.SpawnInfo - 1, LevelTime, Entity->XForm.Pos);
+}
+
+// LiveIndex is in the range of Type. entities spawned here are updated in this
+// step if their type comes later, see UpdateGame
+template <entity_type Type>
+void UpdateEntity(game_state *, u32, f32) {
+}
+
+template <>
+void UpdateEntity<Entity_Type_Bullet>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    auto E = EntityAt(&State->Entities, LiveIndex);
+    
+    vec2 dir = normalizeOrZero(TransformPoint(E->XForm, {0, 1}) - E->XForm.Pos);
+    
+    //E->XForm.Pos.y += Speed * DeltaSeconds;
+    f32 Speed = 1.0f; 
+    E->XForm.Pos = E->XForm.Pos + dir * (Speed * DeltaSeconds);
+    
+    if (ABS(E->XForm.Pos.Y - State->Camera.WorldPosition.Y) >= WorldCameraHeight) {
+        E->MarkedForDeletion = true;
+    }                               
 }
 
-void UpdateFlyPosition (entity *Entity, f32 LevelTime) {
-    assert(Entity->Type == Entity_Type_Fly);
+template <>
+void UpdateEntity<Entity_Type_Enemy_Bullet>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    UpdateEntity<Entity_Type_Bullet>(State, LiveIndex, DeltaSeconds);
+}
+
+template <>
+void UpdateEntity<Entity_Type_Bomb>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    auto E = EntityAt(&State->Entities, LiveIndex);
     
-    if (Entity->fly.Path.Type == Path_Type_Follow) {
-        if (Entity->fly.Path.Following != NULL) {
-            auto DummyFly = Entity->fly.Path.Following->Blueprint;
-            UpdateFlyPosition(&DummyFly, LevelTime + Entity->fly.Path.TransitionTime);
-            Entity->XForm.Pos = DummyFly.XForm.Pos;
-            
-        }
-        return;
+    E->CollisionRadius += DeltaSeconds * 3.0f;
+    E->XForm.Scale = E->CollisionRadius * 3.0f;
+    
+    if (E->CollisionRadius > 6.0f) {
+        E->MarkedForDeletion = true;
     }
+}
+
+template <>
+void UpdateEntity<Entity_Type_Fly>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    auto Entities = &State->Entities;
+    auto E = EntityAt(Entities, LiveIndex);
     
-    if (Entity->fly.Path.Points.Count == 0) 
-        return; 
-    else if (Entity->fly.Path.Points.Count == 1){
-        Entity->XForm.Pos = Entity->fly.Path.Points[0].Position;
+    // shot down in this step, see CollideEnemyWithBullet
+    if (E->MarkedForDeletion)
         return;
-    } 
     
-    u32 MinPathIndex = Entity->fly.Path.Points.Count;
-    f32 Time = LevelTime - Entity->SpawnTime;
+    UpdateFlyPosition(&State->Level, E, State->Level.Time);                
     
-    for (u32 i = Entity->fly.Path.Points.Count; i > 0; i--) {
-        if (Time >= Entity->fly.Path.Points[i - 1].Time) {
-            MinPathIndex = i - 1;
-            break;
-        }
+    E->fly.FireCountdown -= DeltaSeconds;
+    if (E->fly.FireCountdown <= 0)
+    {
+        E->fly.FireCountdown += lerp(Fly_Min_Fire_Interval, Fly_Max_Fire_Interval, randZeroToOne(&State->Random.Fly));
+        
+        auto bullet = NextEntity(Entities, Entity_Type_Enemy_Bullet);
+        bullet->XForm.Pos = E->XForm.Pos;  
+        bullet->XForm.Rotation = lerp(PI * 0.75f, PI * 1.25f, randZeroToOne(&State->Random.Fly)); // points downwards
+        bullet->XForm.Scale = 0.2f;
+        bullet->CollisionRadius = bullet->XForm.Scale * 0.2;
+        bullet->RelativeDrawCenter = vec2 {0.5f, 0.5f};
+        SnapshotXForm(bullet);
     }
+}
+
+template <>
+void UpdateEntity<Entity_Type_Boss>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    auto E = EntityAt(&State->Entities, LiveIndex);
     
-    if (MinPathIndex == Entity->fly.Path.Points.Count) {
-        //fly not on path yet
-        Entity->XForm.Pos = Entity->fly.Path.Points[0].Position;
+    if (State->Camera.WorldPosition.Y + WorldCameraHeight * 0.5f < E->XForm.Pos.Y + E->CollisionRadius * 1.5f) {
+        E->XForm.Pos.Y -= DeltaSeconds;
     }
-    else if (MinPathIndex == (Entity->fly.Path.Points.Count - 1)) {
-        //fly after last point
-        auto LastPoint = &Entity->fly.Path.Points[Entity->fly.Path.Points.Count - 1];
-        f32 TransitionTime = Entity->fly.Path.TransitionTime;
-        
-        switch (Entity->fly.Path.Type) {
-            case Path_Type_Stop: {
-                Entity->XForm.Pos = LastPoint->Position;
-                return;
-            } break;
-            
-            case Path_Type_Loop: {
-                f32 CompleteRound = LastPoint->Time + TransitionTime;
-                
-                if (Time < CompleteRound) {
-                    path_point *FirstPoint = &Entity->fly.Path.Points[0];
-                    f32 l = (Time - LastPoint->Time) / TransitionTime; // == (Time - LastPoint->Time) / (LastPoint->Time + TransitionTime) - LastPoint->Time
-                    
-                    Entity->XForm.Pos = vec2{lerp(LastPoint->Position.X, FirstPoint->Position.X, l),
-                        lerp(LastPoint->Position.Y, FirstPoint->Position.Y, l)
-                    };
-                }
-                else {
-                    f32 CurrentRound = Time - CompleteRound; 
-                    while (CurrentRound > CompleteRound){
-                        CurrentRound -= CompleteRound;     
-                    }
-                    
-                    UpdateFlyPosition(Entity, CurrentRound + Entity->SpawnTime);
-                }
-                return;                
-            }
-            
-            case Path_Type_Reverse: {
-                f32 CurrentRound = Time - LastPoint->Time; 
-                bool OnWayBack = true;
-                
-                while (CurrentRound > LastPoint->Time){
-                    CurrentRound -= LastPoint->Time;
-                    OnWayBack = !OnWayBack;     
-                }
-                
-                if(OnWayBack){
-                    u32 MaxPathIndex;                    
-                    
-                    for (MaxPathIndex = Entity->fly.Path.Points.Count - 1; MaxPathIndex > 0; MaxPathIndex--) {
-                        f32 Time = Entity->fly.Path.Points[MaxPathIndex].Time - Entity->fly.Path.Points[MaxPathIndex - 1].Time;
-                        if (CurrentRound <= Time)
-                            break;
-                        else 
-                            CurrentRound -= Time;
-                    }
-                    auto From = &Entity->fly.Path.Points[MaxPathIndex];
-                    auto To = &Entity->fly.Path.Points[MaxPathIndex - 1];
-                    f32 l = CurrentRound / (From->Time - To->Time);
-                    
-                    Entity->XForm.Pos = vec2{lerp(From->Position.X, To->Position.X, l),
-                        lerp(From->Position.Y, To->Position.Y, l)
-                    };
-                } 
-                else {
-                    UpdateFlyPosition(Entity, CurrentRound + Entity->SpawnTime);
-                }
-                return;
-            } break;
-            
-            //case Path_Type_Follow seperate at the beginning of the function
-            
-            default: {
-                u32 InvalidPathType = 0;
-                assert(InvalidPathType);
-            }
-        }       
+}
+
+template <>
+void UpdateEntity<Entity_Type_Powerup>(game_state *State, u32 LiveIndex, f32 DeltaSeconds) {
+    auto E = EntityAt(&State->Entities, LiveIndex);
+    
+    f32 fallSpeed = 0.8f; 
+    E->XForm.Pos = E->XForm.Pos + vec2{0, -1} * (fallSpeed * DeltaSeconds);          
+}
+
+// the loops over one range, instantiated per type so the kernels get inlined
+// and there is no branch on the type inside the loop
+
+template <entity_type Type>
+void UpdateEntities(game_state *State, f32 DeltaSeconds) {
+    auto Range = TypeRange(&State->Entities, Type);
+    
+    for (u32 i = Range.First; i < Range.End; i++) {
+        UpdateEntity<Type>(State, i, DeltaSeconds);
     }
-    else { 
-        //fly on path
-        path_point *CurrentPath = &Entity->fly.Path.Points[MinPathIndex];
-        path_point *NextPath = &Entity->fly.Path.Points[MinPathIndex + 1];
-        f32 l = (Time - CurrentPath->Time) / (NextPath->Time - CurrentPath->Time);
-        
-        assert(Time < NextPath->Time);
+}
+
+template <entity_type Type>
+void DrawEntities(game_state *State, f32 InterpolationAlpha) {
+    auto Entities = &State->Entities;
+    auto Range = TypeRange(Entities, Type);
+    
+    for (u32 i = Range.First; i < Range.End; i++) {
+        auto Entity = EntityAt(Entities, i);
+        transform XForm = InterpolatedXForm(Entity, InterpolationAlpha);
         
-        Entity->XForm.Pos = vec2{lerp(CurrentPath->Position.X, NextPath->Position.X, l),
-            lerp(CurrentPath->Position.Y, NextPath->Position.Y, l)
-        };
+        DrawEntityCollision(State, Entity, XForm);
+        DrawEntity<Type>(State, Entity, ColdAt(Entities, i), XForm, White_Color);
+    }
+}
+
+template <entity_type Type>
+void DrawOneEntity(game_state *State, entity *Entity, entity_cold *Cold, color Color, f32 InterpolationAlpha) {
+    transform XForm = InterpolatedXForm(Entity, InterpolationAlpha);
+    
+    DrawEntityCollision(State, Entity, XForm);
+    DrawEntity<Type>(State, Entity, Cold, XForm, Color);
+}
+
+struct entity_archetype {
+    entity_type Type; // the row of the table, checked below
+    bool IsSwept; // collides along the way it moved in the last step, not only at its end position
+    
+    void (*UpdateEntities)(game_state *State, f32 DeltaSeconds);
+    void (*DrawEntities)(game_state *State, f32 InterpolationAlpha);
+    void (*DrawEntity)(game_state *State, entity *Entity, entity_cold *Cold, color Color, f32 InterpolationAlpha); // entities outside the pool, like blueprints
+};
+
+#define ENTITY_ARCHETYPE(type, is_swept) { type, is_swept, UpdateEntities<type>, DrawEntities<type>, DrawOneEntity<type> }
+
+// a new entity_type needs a row here, in the order of the enum, a specialization
+// of DrawEntity and one of UpdateEntity if it does anything per step
+constexpr entity_archetype Entity_Archetypes[] = {
+    ENTITY_ARCHETYPE(Entity_Type_Player,       true),
+    ENTITY_ARCHETYPE(Entity_Type_Boss,         false),
+    ENTITY_ARCHETYPE(Entity_Type_Fly,          false),
+    ENTITY_ARCHETYPE(Entity_Type_Bullet,       true),
+    ENTITY_ARCHETYPE(Entity_Type_Bomb,         false),
+    ENTITY_ARCHETYPE(Entity_Type_Powerup,      false),
+    ENTITY_ARCHETYPE(Entity_Type_Enemy_Bullet, true),
+};
+
+constexpr bool IsArchetypeTableInOrder() {
+    for (u32 Type = 0; Type < ARRAY_COUNT(Entity_Archetypes); Type++) {
+        if (Entity_Archetypes[Type].Type != Type)
+            return false;
+    }
+    
+    return true;
+}
+
+static_assert(ARRAY_COUNT(Entity_Archetypes) == Entity_Type_Count, "every entity_type needs an archetype");
+static_assert(IsArchetypeTableInOrder(), "Entity_Archetypes has to be in the order of entity_type");
+
+void DrawEntity(game_state *State, entity *Entity, entity_cold *Cold, color Color = White_Color, f32 InterpolationAlpha = 1.0f) {
+    Entity_Archetypes[Entity->Type].DrawEntity(State, Entity, Cold, Color, InterpolationAlpha);
+}
+
+// grouped by type, so entities with the same texture end up next to each other in the sprite batch
+void DrawAllEntities(game_state *State, f32 InterpolationAlpha = 1.0f) {
+    PROFILE_FUNCTION();
+    
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GEQUAL, 0.1f);    
+    
+    BeginSprites(&Global_Sprite_Batch);
+    
+    for (u32 Type = 0; Type < Entity_Type_Count; Type++) {
+        Entity_Archetypes[Type].DrawEntities(State, InterpolationAlpha);
     }
     
+    EndSprites(&Global_Sprite_Batch);
+    
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
 }
 
 //assuming path are already in order except last point
-u32 SortPath(path_template *Path) {
-    assert(Path->Count > 0);
+u32 SortPath(level *Level, path *Path) {
+    auto Range = &Path->Points;
+    auto Points = GetPathPoints(Level, Path);
+    assert(Range->Count > 0);
     
-    path_point Insert = (*Path)[Path->Count - 1];
+    path_point Insert = Points[Range->Count - 1];
     
-    u32 InsertIndex = Path->Count - 1;
-    for (u32 i = 0; i < Path->Count - 1; i++) {
-        if ((*Path)[i].Time > Insert.Time) {
+    u32 InsertIndex = Range->Count - 1;
+    for (u32 i = 0; i < Range->Count - 1; i++) {
+        if (Points[i].Time > Insert.Time) {
             InsertIndex = i;
             break;
         }
     }
     
     //remove points that are too close in time
-    if (InsertIndex == Path->Count - 1){
-        if ((Path->Count >= 2) && (ABS((*Path)[Path->Count - 2].Time - Insert.Time) < 0.1f)) {
-            (*Path)[Path->Count - 2] = Insert;
-            Pop(Path);    
-            return (Path->Count - 2);
+    if (InsertIndex == Range->Count - 1){
+        if ((Range->Count >= 2) && (ABS(Points[Range->Count - 2].Time - Insert.Time) < 0.1f)) {
+            Points[Range->Count - 2] = Insert;
+            Range->Count--;    
+            return (Range->Count - 2);
         }    
     } 
-    else if  (ABS((*Path)[InsertIndex].Time - Insert.Time) < 0.1f) {
-        (*Path)[InsertIndex] = Insert;
-        Pop(Path);    
+    else if  (ABS(Points[InsertIndex].Time - Insert.Time) < 0.1f) {
+        Points[InsertIndex] = Insert;
+        Range->Count--;    
         return InsertIndex;
     } 
     
-    for (u32 i = Path->Count - 1; i > InsertIndex; i--) {
-        (*Path)[i] =(*Path)[ i - 1];
+    for (u32 i = Range->Count - 1; i > InsertIndex; i--) {
+        Points[i] = Points[i - 1];
     }
-    (*Path)[InsertIndex] = Insert;
+    Points[InsertIndex] = Insert;
     
     return InsertIndex;
 }
 
-void RemovePathPoint(path_template *Path, u32 RemoveIndex ) {
-    assert(RemoveIndex < Path->Count);
+void RemovePathPoint(level *Level, path *Path, u32 RemoveIndex ) {
+    auto Range = &Path->Points;
+    auto Points = GetPathPoints(Level, Path);
+    assert(RemoveIndex < Range->Count);
+    
+    for (u32 i = RemoveIndex; i < Range->Count - 1; i++) {
+        Points[i] = Points[i + 1];
+    }
+    Range->Count--;
+}
+
+// Link is the index + 1 of a spawn info like path.Following,
+// RemovedIndex was removed and LastIndex moved into its place
+void RemapSpawnInfoLink(u32 *Link, u32 RemovedIndex, u32 LastIndex) {
+    if (*Link == RemovedIndex + 1)
+        *Link = 0;
+    else if (*Link == LastIndex + 1)
+        *Link = RemovedIndex + 1;
+}
+
+// swap removes the info and fixes everything that refers to it by index
+void RemoveSpawnInfo(game_state *State, u32 SpawnIndex) {
+    auto Level = &State->Level;
+    auto Infos = &Level->SpawnInfos;
+    auto Lookup = &Level->Lookup;
+    u32 LastIndex = Infos->Count - 1;
+    
+    // followers of the removed info stop following and lead their own chains
+    while (Lookup->FirstFollower[SpawnIndex] != 0) {
+        u32 FollowerIndex = Lookup->FirstFollower[SpawnIndex] - 1;
+        SetFollowing(Level, FollowerIndex, 0);
+    }
+    
+    if ((*Infos)[SpawnIndex].Blueprint.Type == Entity_Type_Fly)
+        SetFollowing(Level, SpawnIndex, 0);
+    
+    SpawnLookupRemove(Lookup, (*Infos)[SpawnIndex].ID);
+    
+    // the last info moves into the removed one, so everything linking to it is relinked
+    if (LastIndex != SpawnIndex) {
+        auto Moved = &(*Infos)[LastIndex];
+        u32 Leader = 0;
+        
+        if (Moved->Blueprint.Type == Entity_Type_Fly) {
+            Leader = Moved->Path.Following;
+            UnlinkFollower(Lookup, Leader, LastIndex);
+            
+            if (Leader == LastIndex + 1)
+                Leader = SpawnIndex + 1;
+        }
+        
+        for (u32 Follower = Lookup->FirstFollower[LastIndex]; Follower != 0; Follower = Lookup->NextFollower[Follower - 1]) {
+            (*Infos)[Follower - 1].Path.Following = SpawnIndex + 1;
+        }
+        
+        Lookup->FirstFollower[SpawnIndex] = Lookup->FirstFollower[LastIndex];
+        (*Infos)[SpawnIndex] = *Moved;
+        
+        if (Moved->Blueprint.Type == Entity_Type_Fly) {
+            (*Infos)[SpawnIndex].Path.Following = Leader;
+            LinkFollower(Lookup, Leader, SpawnIndex);
+        }
+        
+        SpawnLookupInsert(Lookup, Moved->ID, SpawnIndex);
+    }
+    
+    Pop(Infos);
     
-    for (u32 i = RemoveIndex; i < Path->Count - 1; i++) {
-        (*Path)[i] =(*Path)[i + 1];
+    if (LastIndex != SpawnIndex)
+        ResolveFollowers(Level, SpawnIndex);
+    
+    // spawned flies use the path of the info they were spawned from,
+    // flies of the removed info stop where they are
+    for (u32 i = 0; i < State->Entities.Count; i++) {
+        auto Entity = EntityAt(&State->Entities, i);
+        if (Entity->Type == Entity_Type_Fly)
+            RemapSpawnInfoLink(&Entity->fly.SpawnInfo, SpawnIndex, LastIndex);
     }
-    Pop(Path);
+    
+    SpawnQueueRemove(&State->SpawnQueue, SpawnIndex, LastIndex);
+    
+    if (State->Editor.CurrentInfo == Infos->Base + SpawnIndex) 
+        State->Editor.CurrentInfo = NULL;
+    else if (State->Editor.CurrentInfo == Infos->Base + LastIndex)
+        State->Editor.CurrentInfo = Infos->Base + SpawnIndex;
 }
 
 void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font *Font, f32 DeltaSeconds, input GameInput) {
@@ -832,7 +2663,7 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
 #endif
     if (State->Editor.CurrentInfo != NULL) {
         
-        auto Time = &State->Editor.CurrentInfo->Blueprint.fly.Path.TransitionTime;
+        auto Time = &State->Editor.CurrentInfo->Path.TransitionTime;
         if (WasPressed(GameInput.FireKey)) {
             *Time += 1.0f;
         }
@@ -841,27 +2672,35 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
             *Time -= 1.0f;
         } 
         
+        if (WasPressed(GameInput.FireKey) || WasPressed(GameInput.BombKey)) {
+            if (State->Editor.CurrentInfo->Blueprint.Type == Entity_Type_Fly)
+                BakeTrajectory(&State->Level, &State->Editor.CurrentInfo->Path);
+            
+            ResolveFollowers(&State->Level, (u32) (State->Editor.CurrentInfo - State->Level.SpawnInfos.Base));
+        }
+        
         auto Cursor = UiBeginText(Ui, Font, Ui->Width * 0.5f, Ui->Height * 0.5f);
-        UiWrite(&Cursor, "Transition: %f", State->Editor.CurrentInfo->Blueprint.fly.Path.TransitionTime);
+        UiWrite(&Cursor, "Transition: %f", State->Editor.CurrentInfo->Path.TransitionTime);
         
     }
     
-    if (State->Level.SpawnInfos.Count < State->Level.SpawnInfos.Capacity) {    
+    {    
         rect FlyBlueprintRect = MakeRectWithSize(20, Ui->Height - 80, 60, 60);
         UiTexturedRectangle(Ui, State->Assets.FlyTexture, FlyBlueprintRect, MakeRectWithSize(0, 0, State->Assets.FlyTexture.Width, State->Assets.FlyTexture.Height));  
         
         if (UiButton(UiControl, UI_ID0, FlyBlueprintRect)) {
-            entity_spawn_info *Info = Push(&State->Level.SpawnInfos);
-            Info->WasNotSpawned = true;
-            Info->Blueprint = MakeChicken(State->Camera.WorldPosition);
-            Info->Blueprint.SpawnTime = State->Level.Time;
-            Info->ID = UI_ID(&State->Level.SpawnInfos.Count);
-            path_point *Path = Push(&Info->Blueprint.fly.Path.Points);
+            entity_spawn_info *Info = PushSpawnInfo(&State->Level);
+            Info->Blueprint = MakeChicken(&State->Random.Effects, State->Camera.WorldPosition, &Info->Cold);
+            Info->SpawnTime = State->Level.Time;
+            path_point *Path = PushPathPoint(&State->Level, &Info->Path);
             Path->Position = Info->Blueprint.XForm.Pos;
             Path->Time = 0;
-            Info->Blueprint.fly.Path.Type = Path_Type_Stop;
-            Info->Blueprint.fly.Path.TransitionTime = 0.0f;
+            Info->Path.Type = Path_Type_Stop;
+            Info->Path.TransitionTime = 0.0f;
+            BakeTrajectory(&State->Level, &Info->Path);
             State->Editor.CurrentInfo = Info; 
+            
+            SpawnQueueInsert(&State->SpawnQueue, &State->Level.SpawnInfos, (u32) (Info - State->Level.SpawnInfos.Base));
         }
     }
     
@@ -874,29 +2713,33 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
             auto Info = State->Editor.CurrentInfo;
             
             if (UiButton(UiControl, UI_ID0, AddPathRect)) {
-                path_point *PathPoint = Push(&Info->Blueprint.fly.Path.Points);   
+                path_point *PathPoint = PushPathPoint(&State->Level, &Info->Path);   
                 PathPoint->Position = Info->Blueprint.XForm.Pos;
-                PathPoint->Time = State->Level.Time - Info->Blueprint.SpawnTime;                
+                PathPoint->Time = State->Level.Time - Info->SpawnTime;                
                 
-                if (SortPath(&Info->Blueprint.fly.Path.Points) == 0){
-                    if (Info->Blueprint.fly.Path.Points.Count > 1) {
+                if (SortPath(&State->Level, &Info->Path) == 0){
+                    auto Points = GetPathPoints(&State->Level, &Info->Path);
+                    
+                    if (Info->Path.Points.Count > 1) {
                         
-                        f32 AdjustTime = Info->Blueprint.SpawnTime - State->Level.Time;
+                        f32 AdjustTime = Info->SpawnTime - State->Level.Time;
                         
-                        for (u32 i = 1; i < Info->Blueprint.fly.Path.Points.Count; i++) {
-                            Info->Blueprint.fly.Path.Points[i].Time +=  AdjustTime;
+                        for (u32 i = 1; i < Info->Path.Points.Count; i++) {
+                            Points[i].Time +=  AdjustTime;
                         }   
                     }   
                     
-                    Info->Blueprint.fly.Path.Points[0].Time = 0;
-                    Info->Blueprint.SpawnTime = State->Level.Time;              
+                    Points[0].Time = 0;
+                    Info->SpawnTime = State->Level.Time;              
+                    SpawnQueueUpdate(&State->SpawnQueue, &State->Level.SpawnInfos, (u32) (Info - State->Level.SpawnInfos.Base));
                 }
                 
+                BakeTrajectory(&State->Level, &Info->Path);
             }  
             
             texture PathTypeTexture;
             
-            switch(Info->Blueprint.fly.Path.Type) {
+            switch(Info->Path.Type) {
                 case Path_Type_Stop: {
                     PathTypeTexture = State->Assets.PathStopButtonTexture;
                 } break;
@@ -922,40 +2765,77 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
             UiTexturedRectangle(Ui, PathTypeTexture, PathTypeRect, MakeRectWithSize(0, 0, PathTypeTexture.Width, PathTypeTexture.Height));
             
             if (UiButton(UiControl, UI_ID0, PathTypeRect)) {
-                switch (Info->Blueprint.fly.Path.Type) {
+                switch (Info->Path.Type) {
                     case Path_Type_Stop: {
-                        Info->Blueprint.fly.Path.Type = Path_Type_Loop;
+                        Info->Path.Type = Path_Type_Loop;
                     } break;
                     
                     case Path_Type_Loop: {
-                        Info->Blueprint.fly.Path.Type = Path_Type_Reverse;
+                        Info->Path.Type = Path_Type_Reverse;
                     } break;
                     
                     case Path_Type_Reverse: {
-                        Info->Blueprint.fly.Path.Type = Path_Type_Follow;
+                        Info->Path.Type = Path_Type_Follow;
                     } break;
                     
-                    case Path_Type_Follow: {
-                        Info->Blueprint.fly.Path.Type = Path_Type_Stop;
+                    case Path_Type_Follow: 
+                    default: {
+                        Info->Path.Type = Path_Type_Stop;
                     } break;                    
                 }
+                
+                BakeTrajectory(&State->Level, &Info->Path);
+                ResolveFollowers(&State->Level, (u32) (Info - State->Level.SpawnInfos.Base));
+            }
+            
+            rect PathCurveRect = MakeRectWithSize(PathTypeRect.Right + 20, PathTypeRect.Bottom, 64, 64);
+            const char *PathCurveNames[] = { "linear", "catmull", "bezier" };
+            
+            UiRectangle(Ui, PathCurveRect, White_Color, false);
+            auto CurveCursor = UiBeginText(Ui, Font, (PathCurveRect.Left + PathCurveRect.Right) * 0.5f, (PathCurveRect.Bottom + PathCurveRect.Top) * 0.5f, true, White_Color, 0.3f);
+            UiAlignedWrite(CurveCursor, { 0.5f, 0.5f }, "%s", PathCurveNames[Info->Path.Curve]);
+            
+            if (UiButton(UiControl, UI_ID0, PathCurveRect)) {
+                Info->Path.Curve = (path_curve) ((Info->Path.Curve + 1) % Path_Curve_Count);
+                BakeTrajectory(&State->Level, &Info->Path);
+            }
+            
+            auto Points = GetPathPoints(&State->Level, &Info->Path);
+            
+            // curves are drawn on top of the lines between the points
+            if ((Info->Path.Curve != Path_Curve_Linear) && (Info->Path.Points.Count >= 2)) {
+                const u32 Curve_Steps_Per_Point = 8;
+                
+                u32 PointCount = Info->Path.Points.Count;
+                u32 StepCount = (PointCount - 1) * Curve_Steps_Per_Point;
+                f32 FirstTime = Points[0].Time;
+                f32 LastTime = Points[PointCount - 1].Time;
+                
+                path_cursor PathCursor = {};
+                vec2 Previous = Points[0].Position;
+                
+                for (u32 Step = 1; Step <= StepCount; Step++) {
+                    vec2 Position = PathPositionAt(&State->Level, &Info->Path, lerp(FirstTime, LastTime, (f32) Step / StepCount), &PathCursor);
+                    DrawLine(State->Camera, TRANSFORM_IDENTITY, Previous, Position, White_Color); 
+                    Previous = Position;
+                }
             }
             
             // go backwards so latest path point is selected with higher prio
-            for (s32 i = Info->Blueprint.fly.Path.Points.Count - 1; i >= 0; i--)
+            for (s32 i = Info->Path.Points.Count - 1; i >= 0; i--)
             {
-                if(i < Info->Blueprint.fly.Path.Points.Count - 1){
-                    DrawLine(State->Camera, TRANSFORM_IDENTITY, Info->Blueprint.fly.Path.Points[i].Position, Info->Blueprint.fly.Path.Points[i + 1].Position, Blue_Color); 
+                if(i < Info->Path.Points.Count - 1){
+                    DrawLine(State->Camera, TRANSFORM_IDENTITY, Points[i].Position, Points[i + 1].Position, Blue_Color); 
                 }
-                if (Info->Blueprint.fly.Path.Type == Path_Type_Loop){
-                    DrawLine(State->Camera, TRANSFORM_IDENTITY, Info->Blueprint.fly.Path.Points[Info->Blueprint.fly.Path.Points.Count - 1].Position, Info->Blueprint.fly.Path.Points[0].Position, Blue_Color);     
+                if (Info->Path.Type == Path_Type_Loop){
+                    DrawLine(State->Camera, TRANSFORM_IDENTITY, Points[Info->Path.Points.Count - 1].Position, Points[0].Position, Blue_Color);     
                 }
                 
                 u64 ID = UI_ID(i);
                 
-                transform CircleXForm = { Info->Blueprint.fly.Path.Points[i].Position, 0.0f, 0.1f };
+                transform CircleXForm = { Points[i].Position, 0.0f, 0.1f };
                 DrawCircle(State->Camera, CircleXForm, Blue_Color, UiControl->HotId == ID);
-                auto CanvasPoint = WorldToCanvasPoint(State->Camera, Info->Blueprint.fly.Path.Points[i].Position);
+                auto CanvasPoint = WorldToCanvasPoint(State->Camera, Points[i].Position);
                 auto UiPoint = CanvasToUiPoint(Ui, CanvasPoint);
                 auto Cursor = UiBeginText(Ui, Font, UiPoint.X - 10, UiPoint.Y - 10, true, Red_Color, 0.3f);
                 UiWrite(&Cursor, "%d", i);
@@ -969,8 +2849,10 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
                 vec2 DeltaPosition;
                 
                 if (State->Editor.DeleteButtonSelected) {
-                    if (UiButton(UiControl, ID, Rect)) 
-                        RemovePathPoint(&Info->Blueprint.fly.Path.Points, i);
+                    if (UiButton(UiControl, ID, Rect)) {
+                        RemovePathPoint(&State->Level, &Info->Path, i);
+                        BakeTrajectory(&State->Level, &Info->Path);
+                    }
                     
                 } 
                 else if (UiDragable(UiControl, ID, Rect, &DeltaPosition)) {                    
@@ -979,11 +2861,12 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
                     
                     UiPoint = UiPoint + DeltaPosition;
                     auto NewCenterCanvasPoint = UiToCanvasPoint(Ui, UiPoint);
-                    Info->Blueprint.fly.Path.Points[i].Position = CanvasToWorldPoint(State->Camera, NewCenterCanvasPoint);
+                    Points[i].Position = CanvasToWorldPoint(State->Camera, NewCenterCanvasPoint);
+                    BakeTrajectory(&State->Level, &Info->Path);
                 } 
             }
             
-            switch(Info->Blueprint.fly.Path.Type) {
+            switch(Info->Path.Type) {
                 
             }
         }
@@ -1030,13 +2913,17 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
     
     UiLine(Ui, TimeLineRect.Left - 20, Y, TimeLineRect.Right + 10, Y, color{1, 0.7f, 0, 1});
     
+    // scrubbing the timeline restarts the level from there
+    SpawnQueueSeek(&State->SpawnQueue, &State->Level.SpawnInfos, State->Level.Time);
+    
     if (State->Editor.CurrentInfo != NULL) {
         
         if (State->Editor.CurrentInfo->Blueprint.Type == Entity_Type_Fly) {
             u32 XPathPoint = TimeLineRect.Left - 20;
+            auto Points = GetPathPoints(&State->Level, &State->Editor.CurrentInfo->Path);
             
-            for (s32 i = 0; i < State->Editor.CurrentInfo->Blueprint.fly.Path.Points.Count; i++) {
-                u32 YPathpoint = (State->Editor.CurrentInfo->Blueprint.fly.Path.Points[i].Time + State->Editor.CurrentInfo->Blueprint.SpawnTime) / State->Level.Duration * (TimeLineRect.Top - TimeLineRect.Bottom) + TimeLineRect.Bottom;
+            for (s32 i = 0; i < State->Editor.CurrentInfo->Path.Points.Count; i++) {
+                u32 YPathpoint = (Points[i].Time + State->Editor.CurrentInfo->SpawnTime) / State->Level.Duration * (TimeLineRect.Top - TimeLineRect.Bottom) + TimeLineRect.Bottom;
                 
                 auto Cursor = UiBeginText(Ui, &State->Assets.DefaultFont, XPathPoint, YPathpoint, true, Red_Color, 0.3);
                 UiWrite(&Cursor, "%d", i);
@@ -1049,31 +2936,34 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
     
     u32 SpawnIndex = 0;
     
-    glEnable(GL_TEXTURE_2D);
+    // the circles are untextured, FlushSprites turns texturing on for the blueprints itself
+    glDisable(GL_TEXTURE_2D);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_ALPHA_TEST);
     glAlphaFunc(GL_GEQUAL, 0.1f);    
     
+    // the blueprints go into one batch, the depth test keeps them above their circles
+    BeginSprites(&Global_Sprite_Batch);
+    
     while (SpawnIndex < State->Level.SpawnInfos.Count) {
         auto Info = State->Level.SpawnInfos.Base + SpawnIndex;
         bool HasSpawned = false;
         
-        if (State->Level.Time >= Info->Blueprint.SpawnTime) {
+        if (State->Level.Time >= Info->SpawnTime) {
             HasSpawned = true;
             
         }
         if (Info->Blueprint.Type == Entity_Type_Fly) {
-            UpdateFlyPosition(&Info->Blueprint, State->Level.Time);
+            Info->Blueprint.XForm.Pos = FlyPosition(&State->Level, SpawnIndex, State->Level.Time, Info->Blueprint.XForm.Pos);
         }
         
         transform CollisionTransform = Info->Blueprint.XForm;
         CollisionTransform.Scale = 2 * Info->Blueprint.CollisionRadius;
         DrawCircle(State->Camera, CollisionTransform, color{0.3f, 0.3f, 0.0f, 1.0f}, false, 16, -0.5f);
         
-        glEnable(GL_TEXTURE_2D);
-        DrawEntity(State, &Info->Blueprint, color {1, 1, 1, (HasSpawned ? 1.0f : 0.3f)});
-        glDisable(GL_TEXTURE_2D);
+        DrawEntity(State, &Info->Blueprint, &Info->Cold, color {1, 1, 1, (HasSpawned ? 1.0f : 0.3f)});
+        
         // collision center
         auto CanvasPoint = WorldToCanvasPoint(State->Camera, Info->Blueprint.XForm.Pos);
         auto UiPoint = CanvasToUiPoint(Ui, CanvasPoint);
@@ -1106,30 +2996,13 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
         if(State->Editor.DeleteButtonSelected) {
             if (UiButton(UiControl, Id, Rect)) 
             {
-                u64 IDDeleted = State->Level.SpawnInfos[SpawnIndex].ID;
-                
-                for(u32 i = 0; i < State->Level.SpawnInfos.Count; i++) {
-                    if (State->Level.SpawnInfos[i].Blueprint.Type != Entity_Type_Fly)
-                        continue;
-                    else if (State->Level.SpawnInfos[i].Blueprint.fly.Path.IDFollowing == IDDeleted) {
-                        State->Level.SpawnInfos[i].Blueprint.fly.Path.IDFollowing = 0;
-                        State->Level.SpawnInfos[i].Blueprint.fly.Path.Following = NULL;
-                    }                    
-                }
-                
-                State->Level.SpawnInfos[SpawnIndex] = State->Level.SpawnInfos[State->Level.SpawnInfos.Count - 1]; 
-                Pop(&State->Level.SpawnInfos);  
-                
-                if (State->Editor.CurrentInfo == Info) 
-                    State->Editor.CurrentInfo = NULL;
-                
+                RemoveSpawnInfo(State, SpawnIndex);
             }
         }
         else {
             if (UiButton(UiControl, Id, Rect, 2)) {
                 if (State->Editor.CurrentInfo != NULL && GameInput.SlowMovementKey.IsPressed) {
-                    State->Editor.CurrentInfo->Blueprint.fly.Path.Following = Info;
-                    State->Editor.CurrentInfo->Blueprint.fly.Path.IDFollowing = Info->ID;
+                    SetFollowing(&State->Level, (u32) (State->Editor.CurrentInfo - State->Level.SpawnInfos.Base), SpawnIndex + 1);
                 } 
                 else 
                     State->Editor.CurrentInfo = Info;
@@ -1137,10 +3010,12 @@ void UpdateEditor(game_state *State, ui_context *Ui, ui_control *UiControl, font
         }        
         SpawnIndex++;
     }
+    
+    EndSprites(&Global_Sprite_Batch);
 }
 
 void UpdateGameOver(game_state *State, input GameInput, ui_context *Ui, font *Font, f32 DeltaSeconds){
-    State->Player->XForm.Rotation += 2 * PI * DeltaSeconds;
+    GetPlayer(State)->XForm.Rotation += 2 * PI * DeltaSeconds;
     
     if (WasPressed(GameInput.EnterKey)) {
         initGame(State);
@@ -1166,248 +3041,375 @@ void UpdateGameOver(game_state *State, input GameInput, ui_context *Ui, font *Fo
     DrawAllEntities(State);                            
 }
 
-void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *UiControl, font *Font, f32 DeltaSeconds){    
+// collision responses, Entities[0] and Entities[1] have the types of the rule in that order.
+// the entity the rule consumes is marked for deletion before the response.
+// returning false ends the simulation step
+
+bool CollidePlayerWithPowerup(game_state *, collision *Collision, f32 DeltaSeconds) {
+    auto Player = Collision->Entities[0];
+    auto Powerup = Collision->Entities[1];
     
-    //State->Camera.WorldPosition.y += DeltaSeconds;
+    auto Distance = Player->XForm.Pos - Powerup->XForm.Pos;
     
-    auto Entities = &State->Entities;
-    entity *Boss = NULL;
+    if (lengthSquared(Distance) <= Powerup_Collect_Radius * Powerup_Collect_Radius) {
+        Powerup->MarkedForDeletion = true;
+        Player->player.Power++;
+    }
+    else {
+        Powerup->XForm.Pos = Powerup->XForm.Pos + normalizeOrZero(Distance) * (Powerup_Magnet_Speed * DeltaSeconds);
+    }                
     
-    //same as State.inEditMode ^= WasPressed(...)
+    return true;
+}
+
+bool CollidePlayerWithEnemy(game_state *State, collision *, f32) {
+    State->Mode = Mode_Game_Over;
     
-    State->Level.Time += DeltaSeconds;
-    State->Level.Time = MIN(State->Level.Time, State->Level.Duration);
+    if (!State->IsHeadless) {
+        Mix_FadeOutMusic(500);
+        Mix_HaltChannel(-1);
+        Mix_PlayChannel(0, State->Assets.SfxDeath, 0);
+    }
     
-    for (u32 i = 0; i <Entities->Count; i++) {
-        if (Entities->Base[i].Type == Entity_Type_Boss) {
-            Boss = Entities->Base + i;
-            break;
-        } 
+    return false;
+}
+
+// fly or boss. a fly dies right here, so its kernel never has to look at its Hp
+bool CollideEnemyWithBullet(game_state *State, collision *Collision, f32) {
+    auto Enemy = Collision->Entities[0];
+    auto EnemyCold = Collision->Colds[0];
+    auto Bullet = Collision->Entities[1];
+    
+    EnemyCold->Hp -= Bullet->bullet.Damage;  
+    EnemyCold->BlinkEndTime = State->Level.Time + EnemyCold->BlinkDuration;
+    
+    // several bullets can hit in the same step, only the first kill drops a powerup
+    if ((Enemy->Type == Entity_Type_Fly) && (EnemyCold->Hp <= 0) && !Enemy->MarkedForDeletion) {
+        Enemy->MarkedForDeletion = true;
+        
+        entity *Powerup = NextEntity(&State->Entities, Entity_Type_Powerup);
+        Powerup->XForm.Pos = Enemy->XForm.Pos;  
+        Powerup->XForm.Rotation = 0.0f;
+        Powerup->XForm.Scale = 0.02f;
+        Powerup->CollisionRadius = Powerup_Collect_Radius * 3;
+        Powerup->RelativeDrawCenter = vec2 {0.5f, 0.5f};
+        SnapshotXForm(Powerup);
     }
     
-    for (u32 SpawnIndex = 0; SpawnIndex < State->Level.SpawnInfos.Count; SpawnIndex++) {
-        auto Info = State->Level.SpawnInfos.Base + SpawnIndex;
-        if (Info->WasNotSpawned && (Info->Blueprint.SpawnTime <= State->Level.Time))
-        {
-            auto Entity = NextEntity(Entities);
-            
-            if (Entity != NULL) {
-                *Entity = Info->Blueprint;
-                Info->WasNotSpawned = false;
-            }
-        }  
-    }      
+    return true;
+}
+
+// the bullet is consumed, nothing else happens
+bool CollideBombWithBullet(game_state *, collision *, f32) {
+    return true;
+}
+
+typedef bool collision_response(game_state *State, collision *Collision, f32 DeltaSeconds);
+
+enum collision_consume {
+    Collision_Consume_None,
+    Collision_Consume_A,
+    Collision_Consume_B,
+};
+
+// an entity can only be consumed once per step, so a bullet that overlaps
+// several flies only damages one of them
+struct collision_rule {
+    entity_type A, B;
+    collision_response *Response;
+    collision_consume Consume;
+};
+
+// every pair of types that can collide, all other pairs are never tested
+constexpr collision_rule Collision_Rules[] = {
+    { Entity_Type_Player, Entity_Type_Powerup,      CollidePlayerWithPowerup, Collision_Consume_None },
+    { Entity_Type_Player, Entity_Type_Boss,         CollidePlayerWithEnemy,   Collision_Consume_None },
+    { Entity_Type_Player, Entity_Type_Fly,          CollidePlayerWithEnemy,   Collision_Consume_None },
+    { Entity_Type_Player, Entity_Type_Enemy_Bullet, CollidePlayerWithEnemy,   Collision_Consume_None },
+    { Entity_Type_Fly,    Entity_Type_Bullet,       CollideEnemyWithBullet,   Collision_Consume_B },
+    { Entity_Type_Boss,   Entity_Type_Bullet,       CollideEnemyWithBullet,   Collision_Consume_B },
+    { Entity_Type_Bomb,   Entity_Type_Enemy_Bullet, CollideBombWithBullet,    Collision_Consume_B },
+};
+
+struct collision_pair {
+    collision_response *Response; // NULL if the types never collide
+    collision_consume Consume;
+    bool Swap; // the entities are in the opposite order of the rule
+};
+
+struct collision_table {
+    collision_pair Pairs[Entity_Type_Count][Entity_Type_Count];
+    u32 Masks[Entity_Type_Count]; // FLAG() of every type the type collides with
+};
+
+constexpr collision_table MakeCollisionTable() {
+    collision_table Result = {};
     
-    //bullet movement        
-    if (State->BulletSpawnCooldown > 0) State->BulletSpawnCooldown -= DeltaSeconds;
+    for (u32 i = 0; i < ARRAY_COUNT(Collision_Rules); i++) {
+        auto Rule = Collision_Rules[i];
+        
+        Result.Pairs[Rule.B][Rule.A].Response = Rule.Response;
+        Result.Pairs[Rule.B][Rule.A].Consume = Rule.Consume;
+        Result.Pairs[Rule.B][Rule.A].Swap = (Rule.A != Rule.B);
+        Result.Pairs[Rule.A][Rule.B].Response = Rule.Response;
+        Result.Pairs[Rule.A][Rule.B].Consume = Rule.Consume;
+        Result.Pairs[Rule.A][Rule.B].Swap = false;
+        
+        Result.Masks[Rule.A] |= FLAG(Rule.B);
+        Result.Masks[Rule.B] |= FLAG(Rule.A);
+    }
     
-    vec2 Direction = {};
-    f32 Speed = 1.0f;
+    return Result;
+}
+
+static_assert(Entity_Type_Count <= 32, "collision masks have one bit per entity_type");
+
+constexpr collision_table Collision_Table = MakeCollisionTable();
+
+// puts the entities in the order of their collision rule
+void PushCollision(collision *Collision, entity *A, entity_cold *ColdA, entity *B, entity_cold *ColdB) {
+    if (!Collision_Table.Pairs[A->Type][B->Type].Swap) {
+        *Collision = { { A, B }, { ColdA, ColdB } };
+    }
+    else {
+        *Collision = { { B, A }, { ColdB, ColdA } };
+    }
+}
+
+// how far the entity moved in the last step, zero if it isn't swept
+vec2 CollisionMotion(entity *Entity) {
+    if (!Entity_Archetypes[Entity->Type].IsSwept || !Entity->HasPrevXForm)
+        return {};
+    
+    return Entity->XForm.Pos - Entity->PrevXForm.Pos;
+}
+
+bool areColliding(entity *A, entity *B) {
+    return areIntersectingSwept(circle{A->XForm.Pos, A->CollisionRadius}, CollisionMotion(A), circle{B->XForm.Pos, B->CollisionRadius}, CollisionMotion(B));
+}
+
+// the collisions are pushed to Arena. swept entities go into the broadphase
+// with the bounds of their way, their pairs are tested again with areColliding
+collision *FindCollisions(entity_pool *Entities, broadphase_grid *Broadphase, memory_arena *Arena, u32 *CollisionCount) {
+    PROFILE_FUNCTION();
+    
+    BroadphaseBegin(Broadphase, Entities->Count);
     
-    collision Collisions[1024];
+    // types that collide with nothing don't go into the grid at all
+    for (u32 Type = 0; Type < Entity_Type_Count; Type++) {
+        u32 Mask = Collision_Table.Masks[Type];
+        if (!Mask)
+            continue;
+        
+        auto Range = TypeRange(Entities, (entity_type) Type);
+        for (u32 i = Range.First; i < Range.End; i++) {
+            auto E = EntityAt(Entities, i);
+            BroadphaseAdd(Broadphase, i, sweptBounds(circle{E->XForm.Pos, E->CollisionRadius}, CollisionMotion(E)), FLAG(Type), Mask);
+        }
+    }
+    
+    BroadphaseEnd(Broadphase);
+    
+    auto Collisions = PUSH_ARRAY(Arena, collision, Broadphase->PairCount);
+    u32 Count = 0;
+    
+    for (u32 i = 0; i < Broadphase->PairCount; i++) {
+        u32 A = Broadphase->Pairs[i].Indices[0];
+        u32 B = Broadphase->Pairs[i].Indices[1];
+        
+        bool IsSwept = (Entity_Archetypes[EntityAt(Entities, A)->Type].IsSwept || Entity_Archetypes[EntityAt(Entities, B)->Type].IsSwept);
+        if (IsSwept && !areColliding(EntityAt(Entities, A), EntityAt(Entities, B)))
+            continue;
+        
+        PushCollision(Collisions + (Count++), EntityAt(Entities, A), ColdAt(Entities, A), EntityAt(Entities, B), ColdAt(Entities, B));
+    }
+    
+    *CollisionCount = Count;
+    return Collisions;
+}
+
+#ifdef STRESS_TEST
+
+// the old O(n^2) pair loop, only kept to compare against the broadphase
+u32 FindCollisionsBruteForce(entity_pool *Entities, collision *Collisions, u32 MaxCollisionCount) {
     u32 CollisionCount = 0;
     
     for(u32 i = 0; i < Entities->Count; i++) {
-        bool DoBreak = false;
-        
         for (u32 j = i + 1; j < Entities->Count; j++){
+            auto A = EntityAt(Entities, i);
+            auto B = EntityAt(Entities, j);
             
-            if (!(Entities->Base[i].CollisionTypeMask & FLAG(Entities->Base[j].Type)))
+            if (!Collision_Table.Pairs[A->Type][B->Type].Response)
                 continue;
             
-            if (!(Entities->Base[j].CollisionTypeMask & FLAG(Entities->Base[i].Type)))
-                continue;
-            
-            if (areIntersecting(circle{Entities->Base[i].XForm.Pos, Entities->Base[i].CollisionRadius}, circle{Entities->Base[j].XForm.Pos, Entities->Base[j].CollisionRadius})) 
-            {
-                if (CollisionCount >= ARRAY_COUNT(Collisions)) {
-                    DoBreak = true;
-                    break;
-                }
-                
-                auto newCollision = Collisions + (CollisionCount++);               
+            if (areColliding(A, B)) {
+                if (CollisionCount >= MaxCollisionCount)
+                    return CollisionCount;
                 
-                if (Entities->Base[i].Type < Entities->Base[j].Type) {
-                    newCollision->Entities[0] = (Entities->Base) + i;
-                    newCollision->Entities[1] = (Entities->Base) + j;
-                }
-                else {
-                    newCollision->Entities[1] = (Entities->Base) + i;
-                    newCollision->Entities[0] = (Entities->Base) + j;
-                }
+                PushCollision(Collisions + (CollisionCount++), A, ColdAt(Entities, i), B, ColdAt(Entities, j));
             }
         }
-        
-        if(DoBreak) {
+    }
+    
+    return CollisionCount;
+}
+
+// keeps the screen filled with player bullets and tanky flies that never shoot
+void SpawnStressEntities(game_state *State) {
+    auto Entities = &State->Entities;
+    
+    auto Bullets = TypeRange(Entities, Entity_Type_Bullet);
+    auto Flies = TypeRange(Entities, Entity_Type_Fly);
+    
+    u32 BulletCount = Bullets.End - Bullets.First;
+    u32 FlyCount = Flies.End - Flies.First;
+    
+    for (; FlyCount < Stress_Fly_Count; FlyCount++) {
+        entity_cold *Cold;
+        entity *Fly = NextEntity(Entities, Entity_Type_Fly, NULL, &Cold);
+        *Fly = MakeChicken(&State->Random.Spawn, vec2{}, Cold);
+        Fly->XForm.Pos = vec2{ randMinusOneToOne(&State->Random.Spawn) * State->WorldWidth * 0.5f, State->Camera.WorldPosition.Y + randZeroToOne(&State->Random.Spawn) * WorldCameraHeight * 0.5f };
+        Cold->MaxHp = 1000000;
+        Cold->Hp = Cold->MaxHp;
+        Fly->fly.FireCountdown = f32_max;
+        SnapshotXForm(Fly);
+    }
+    
+    for (; BulletCount < Stress_Bullet_Count; BulletCount++) {
+        entity *Bullet = NextEntity(Entities, Entity_Type_Bullet);
+        Bullet->XForm.Pos = vec2{ randMinusOneToOne(&State->Random.Spawn) * State->WorldWidth * 0.5f, State->Camera.WorldPosition.Y + randMinusOneToOne(&State->Random.Spawn) * WorldCameraHeight * 0.5f };
+        Bullet->XForm.Scale = 0.2f;
+        Bullet->XForm.Rotation = randMinusOneToOne(&State->Random.Spawn) * PI * 0.25f;
+        Bullet->CollisionRadius = Bullet->XForm.Scale * 0.2;
+        Bullet->RelativeDrawCenter = vec2 {0.5f, 0.5f};
+        Bullet->bullet.Damage = 1;
+        SnapshotXForm(Bullet);
+    }
+}
+
+#endif
+
+entity *FindBoss(entity_pool *Entities, entity_cold **Cold = NULL) {
+    auto Bosses = TypeRange(Entities, Entity_Type_Boss);
+    if (Bosses.First == Bosses.End)
+        return NULL;
+    
+    if (Cold)
+        *Cold = ColdAt(Entities, Bosses.First);
+    
+    return EntityAt(Entities, Bosses.First);
+}
+
+// one simulation step, DeltaSeconds is always Sim_Delta_Seconds when called from AdvanceGame
+void UpdateGame(game_state *State, input GameInput, f32 DeltaSeconds){    
+    PROFILE_FUNCTION();
+    
+    //State->Camera.WorldPosition.y += DeltaSeconds;
+    
+    auto Entities = &State->Entities;
+    auto Player = GetPlayer(State);
+    entity *Boss = FindBoss(Entities);
+    
+    //same as State.inEditMode ^= WasPressed(...)
+    
+    State->Level.Time += DeltaSeconds;
+    State->Level.Time = MIN(State->Level.Time, State->Level.Duration);
+    
+    PROFILE_BEGIN("spawn");
+    auto SpawnQueue = &State->SpawnQueue;
+    while (SpawnQueue->Cursor < SpawnQueue->Count) {
+        u32 InfoIndex = SpawnQueue->Indices[SpawnQueue->Cursor];
+        auto Info = State->Level.SpawnInfos.Base + InfoIndex;
+        if (Info->SpawnTime > State->Level.Time)
             break;
+        
+        entity_cold *Cold;
+        auto Entity = NextEntity(Entities, Info->Blueprint.Type, NULL, &Cold);
+        *Entity = Info->Blueprint;
+        *Cold = Info->Cold;
+        
+        // a fly starts where its path is, not where the editor left the blueprint
+        if (Entity->Type == Entity_Type_Fly) {
+            Entity->fly.SpawnInfo = InfoIndex + 1;
+            UpdateFlyPosition(&State->Level, Entity, State->Level.Time);
         }
-    }
+        
+        SnapshotXForm(Entity);
+        SpawnQueue->Cursor++;
+    }      
+    PROFILE_END();
+    
+    //bullet movement        
+    if (State->BulletSpawnCooldown > 0) State->BulletSpawnCooldown -= DeltaSeconds;
+    
+    vec2 Direction = {};
+    f32 Speed = 1.0f;
+    
+#ifdef STRESS_TEST
+    SpawnStressEntities(State);
+    u64 CollisionStartTime = SDL_GetPerformanceCounter();
+#endif
+    
+    u32 CollisionCount;
+    auto Collisions = FindCollisions(Entities, &State->Broadphase, &Global_Frame_Arena, &CollisionCount);
+    
+#ifdef STRESS_TEST
+    u64 CollisionEndTime = SDL_GetPerformanceCounter();
+    
+    // one more than the broadphase found, so extra collisions still show up as a mismatch
+    auto BruteForceCollisions = PUSH_ARRAY(&Global_Frame_Arena, collision, CollisionCount + 1);
+    u32 BruteForceCollisionCount = FindCollisionsBruteForce(Entities, BruteForceCollisions, CollisionCount + 1);
+    u64 BruteForceEndTime = SDL_GetPerformanceCounter();
     
+    f64 CounterToMilliseconds = 1000.0 / SDL_GetPerformanceFrequency();
+    State->Stress.CollisionMilliseconds = (CollisionEndTime - CollisionStartTime) * CounterToMilliseconds;
+    State->Stress.BruteForceMilliseconds = (BruteForceEndTime - CollisionEndTime) * CounterToMilliseconds;
+    State->Stress.CollisionCount = CollisionCount;
+    State->Stress.BruteForceCollisionCount = BruteForceCollisionCount;
+#endif
+    
+    auto Stats = &State->CollisionStats;
+    Stats->PairCount = CollisionCount;
+    Stats->ConsumedCount = 0;
+    Stats->MaxPairCount = MAX(Stats->MaxPairCount, CollisionCount);
+    Stats->TotalPairCount += CollisionCount;
+    
+    // nothing is marked for deletion before this, so MarkedForDeletion means consumed or shot down in this step
     for (u32 i = 0; i < CollisionCount; i++) {
         auto Current = Collisions + i;
         
-        switch (FLAG(Current->Entities[0]->Type) | FLAG(Current->Entities[1]->Type)) {
-            case (FLAG(Entity_Type_Player) | FLAG(Entity_Type_Powerup)): {
-                auto Player = Current->Entities[0];
-                auto Powerup = Current->Entities[1];
-                assert((State->Player->Type == Entity_Type_Player) && (Powerup->Type == Entity_Type_Powerup));
-                
-                
-                auto Distance = State->Player->XForm.Pos - Powerup->XForm.Pos;
-                
-                if (lengthSquared(Distance) <= Powerup_Collect_Radius * Powerup_Collect_Radius) {
-                    Powerup->MarkedForDeletion = true;
-                    State->Player->player.Power++;
-                }
-                else {
-                    Powerup->XForm.Pos = Powerup->XForm.Pos + normalizeOrZero(Distance) * (Powerup_Magnet_Speed * DeltaSeconds);
-                }                
-            } break;
-            
-            case (FLAG(Entity_Type_Bullet) | FLAG(Entity_Type_Fly)): {
-                auto Fly = Current->Entities[0];
-                auto Bullet = Current->Entities[1];
-                
-                assert((Fly->Type == Entity_Type_Fly) && (Bullet->Type == Entity_Type_Bullet));
-                
-                Bullet->MarkedForDeletion = true;
-                Fly->Hp -= Bullet->bullet.Damage;  
-                Fly->BlinkTime = Fly->BlinkDuration;
-                
-            } break;
-            
-            case (FLAG(Entity_Type_Bullet) | FLAG(Entity_Type_Boss)): {
-                auto Boss = Current->Entities[0];
-                auto Bullet = Current->Entities[1];
-                
-                assert((Boss->Type == Entity_Type_Boss) && (Bullet->Type == Entity_Type_Bullet));
-                
-                Bullet->MarkedForDeletion = true;
-                Boss->Hp -= Bullet->bullet.Damage;
-                Boss->BlinkTime = Boss->BlinkDuration;
-                
-            } break;   
+        auto Pair = Collision_Table.Pairs[Current->Entities[0]->Type][Current->Entities[1]->Type];
+        assert(Pair.Response);
+        
+        if (Pair.Consume != Collision_Consume_None) {
+            auto Consumed = Current->Entities[Pair.Consume - Collision_Consume_A];
             
-            case (FLAG(Entity_Type_Bomb) | FLAG(Entity_Type_Bullet)): {
-                auto Bullet = Current->Entities[0];
-                auto Bomb = Current->Entities[1];
-                
-                assert((Bomb->Type == Entity_Type_Bomb) && (Bullet->Type == Entity_Type_Bullet));
-                
-                Bullet->MarkedForDeletion = true;               
-            } break;
+            if (Consumed->MarkedForDeletion) {
+                Stats->ConsumedCount++;
+                Stats->TotalConsumedCount++;
+                continue;
+            }
             
-            case (FLAG(Entity_Type_Bullet) | FLAG(Entity_Type_Player)): 
-            case (FLAG(Entity_Type_Player) | FLAG(Entity_Type_Boss)): 
-            case (FLAG(Entity_Type_Player) | FLAG(Entity_Type_Fly)): {
-                
-                auto Player = Current->Entities[0];
-                //auto Enemy = Current->Entities[1];
-                
-                assert(State->Player->Type == Entity_Type_Player);
-                
-                State->Mode = Mode_Game_Over;
-                Mix_FadeOutMusic(500);
-                Mix_HaltChannel(-1);
-                Mix_PlayChannel(0, State->Assets.SfxDeath, 0);
-                return;
-                
-            } break;  
+            Consumed->MarkedForDeletion = true;
         }
+        
+        if (!Pair.Response(State, Current, DeltaSeconds))
+            return;
     }
     
-    for(u32 i = 0; i < Entities->Count; i++) {
-        
-        auto E = Entities->Base + i;
-        
-        switch(E->Type) {
-            case Entity_Type_Bullet: {
-                
-                vec2 dir = normalizeOrZero(TransformPoint(E->XForm, {0, 1}) - E->XForm.Pos);
-                
-                //E->XForm.Pos.y += Speed * DeltaSeconds;
-                f32 Speed = 1.0f; 
-                E->XForm.Pos = E->XForm.Pos + dir * (Speed * DeltaSeconds);
-                
-                if (ABS(E->XForm.Pos.Y - State->Camera.WorldPosition.Y) >= WorldCameraHeight) {
-                    E->MarkedForDeletion = true;
-                }                               
-            } break;
-            
-            case Entity_Type_Bomb: {
-                E->CollisionRadius += DeltaSeconds * 3.0f;
-                E->XForm.Scale = E->CollisionRadius * 3.0f / (State->Assets.BombTexture.Height * Default_World_Units_Per_Texel);
-                
-                if (E->CollisionRadius > 6.0f) {
-                    E->MarkedForDeletion = true;
-                }
-            } break;
-            
-            case Entity_Type_Fly:{
-                if (E->Hp <= 0) {
-                    E->MarkedForDeletion = true;
-                    
-                    entity *Powerup = NextEntity(Entities);
-                    
-                    if (Powerup)
-                    {
-                        Powerup->XForm.Pos = E->XForm.Pos;  
-                        Powerup->XForm.Rotation = 0.0f;
-                        Powerup->XForm.Scale = 0.02f;
-                        Powerup->CollisionRadius = Powerup_Collect_Radius * 3;
-                        Powerup->Type = Entity_Type_Powerup;
-                        Powerup->CollisionTypeMask = FLAG(Entity_Type_Player); 
-                        Powerup->RelativeDrawCenter = vec2 {0.5f, 0.5f};
-                    }
-                } 
-                
-                UpdateFlyPosition(E, State->Level.Time);                
-                
-                E->fly.FireCountdown -= DeltaSeconds;
-                if (E->fly.FireCountdown <= 0)
-                {
-                    E->fly.FireCountdown += lerp(Fly_Min_Fire_Interval, Fly_Max_Fire_Interval, randZeroToOne());
-                    
-                    auto bullet = NextEntity(Entities);
-                    if (bullet)
-                    {
-                        bullet->Type = Entity_Type_Bullet;
-                        bullet->CollisionTypeMask |= FLAG(Entity_Type_Player) | FLAG(Entity_Type_Bomb);
-                        bullet->XForm.Pos = E->XForm.Pos;  
-                        bullet->XForm.Rotation = lerp(PI * 0.75f, PI * 1.25f, randZeroToOne()); // points downwards
-                        bullet->XForm.Scale = 0.2f;
-                        bullet->CollisionRadius = bullet->XForm.Scale * 0.2;
-                        bullet->RelativeDrawCenter = vec2 {0.5f, 0.5f};
-                    }
-                }
-                
-                if (E->BlinkTime > 0) E->BlinkTime -= DeltaSeconds;
-            } break;
-            
-            case Entity_Type_Boss:{
-                if (E->BlinkTime > 0) E->BlinkTime -= DeltaSeconds;
-                if (State->Camera.WorldPosition.Y + WorldCameraHeight * 0.5f < E->XForm.Pos.Y + E->CollisionRadius * 1.5f) {
-                    E->XForm.Pos.Y -= DeltaSeconds;
-                }
-            } break;
-            
-            case Entity_Type_Powerup: {                
-                f32 fallSpeed = 0.8f; 
-                E->XForm.Pos = E->XForm.Pos + vec2{0, -1} * (fallSpeed * DeltaSeconds);          
-            } break;
-        }
+    // only after the collisions, they test the way from PrevXForm to XForm of the last step
+    for (u32 i = 0; i < Entities->Count; i++) {
+        SnapshotXForm(EntityAt(Entities, i));
     }
     
-    u32 i = 0;
-    while (i < Entities->Count) {
-        if (Entities->Base[i].MarkedForDeletion) {
-            Entities->Base[i] = Entities->Base[(Entities->Count) - 1];
-            Pop(Entities);
-        }
-        else{ 
-            i++;
-        }
+    PROFILE_BEGIN("entity update");
+    // in type order, so bullets and powerups spawned by flies are updated in the same step
+    for (u32 Type = 0; Type < Entity_Type_Count; Type++) {
+        Entity_Archetypes[Type].UpdateEntities(State, DeltaSeconds);
     }
+    PROFILE_END();
+    
+    RemoveMarkedEntities(Entities);
     
     if (WasPressed(GameInput.EnterKey)) {
         initGame(State);
@@ -1417,12 +3419,12 @@ void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *
     //player movement
     if (GameInput.LeftKey.IsPressed) {
         Direction.X -= 1;
-        //State->Player->XForm.Rotation -= 0.5f * PI * DeltaSeconds;
+        //Player->XForm.Rotation -= 0.5f * PI * DeltaSeconds;
     }
     
     if (GameInput.RightKey.IsPressed) {
         Direction.X += 1; 
-        //State->Player->XForm.Rotation += 0.5f * PI * DeltaSeconds;
+        //Player->XForm.Rotation += 0.5f * PI * DeltaSeconds;
     }
     
     if (GameInput.UpKey.IsPressed) {
@@ -1438,28 +3440,28 @@ void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *
     }
     
     Direction = normalizeOrZero(Direction);            
-    State->Player->XForm.Pos = State->Player->XForm.Pos + Direction * (Speed * DeltaSeconds);
+    Player->XForm.Pos = Player->XForm.Pos + Direction * (Speed * DeltaSeconds);
     
-    State->Player->XForm.Pos.Y = CLAMP(State->Player->XForm.Pos.Y , -1.0f + State->Player->CollisionRadius + State->Camera.WorldPosition.Y, 1.0f - State->Player->CollisionRadius + State->Camera.WorldPosition.Y);
+    Player->XForm.Pos.Y = CLAMP(Player->XForm.Pos.Y , -1.0f + Player->CollisionRadius + State->Camera.WorldPosition.Y, 1.0f - Player->CollisionRadius + State->Camera.WorldPosition.Y);
     
     // WorldWidth = windowWidth / windowHeight * worldHeight 
     // worldHeight = 2 (from -1 to 1)               
-    State->Player->XForm.Pos.X = CLAMP(State->Player->XForm.Pos.X, -State->WorldWidth * 0.5f + State->Player->CollisionRadius, State->WorldWidth * 0.5f - State->Player->CollisionRadius);
+    Player->XForm.Pos.X = CLAMP(Player->XForm.Pos.X, -State->WorldWidth * 0.5f + Player->CollisionRadius, State->WorldWidth * 0.5f - Player->CollisionRadius);
     {
 #if 0
-        f32 Rotation = asin((enemies[0].XForm.Pos.x - State->Player->XForm.Pos.x) / length(enemies[0].XForm.Pos - State->Player->XForm.Pos));
-        if (enemies[0].XForm.Pos.y < State->Player->XForm.Pos.y) {
+        f32 Rotation = asin((enemies[0].XForm.Pos.x - Player->XForm.Pos.x) / length(enemies[0].XForm.Pos - Player->XForm.Pos));
+        if (enemies[0].XForm.Pos.y < Player->XForm.Pos.y) {
             Rotation = Rotation - PI;
         }
         else {
             Rotation = 2 * PI - Rotation;
         }
         
-        State->Player->XForm.Rotation = Rotation;
+        Player->XForm.Rotation = Rotation;
         
 #else
         if (Boss)
-            State->Player->XForm.Rotation = LookAtRotation(State->Player->XForm.Pos, Boss->XForm.Pos);
+            Player->XForm.Rotation = LookAtRotation(Player->XForm.Pos, Boss->XForm.Pos);
         
         
 #endif
@@ -1467,50 +3469,48 @@ void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *
     
     if(GameInput.FireKey.IsPressed) {
         if ((State->BulletSpawnCooldown <= 0)) {
-            entity *Bullet = NextEntity(Entities);
-            
-            if (Bullet != NULL) {
-                Bullet->XForm.Pos = State->Player->XForm.Pos;
-                Bullet->XForm.Scale = 0.2f;
-                Bullet->XForm.Rotation = 0;
-                Bullet->CollisionRadius = Bullet->XForm.Scale * 0.2;
-                Bullet->Type = Entity_Type_Bullet;
-                Bullet->CollisionTypeMask = FLAG(Entity_Type_Boss) | FLAG(Entity_Type_Fly);
-                Bullet->RelativeDrawCenter = vec2 {0.5f, 0.5f};
-                
-                Bullet->bullet.Damage = (State->Player->player.Power / 20) + 1;
-                Bullet->bullet.Damage = MIN(Bullet->bullet.Damage, 3);
-                
-                State->BulletSpawnCooldown += 0.05f;
-                
-                //                        Mix_PlayChannel(0, sfxShoot, 0);
-            }
+            entity *Bullet = NextEntity(Entities, Entity_Type_Bullet);
+            Bullet->XForm.Pos = Player->XForm.Pos;
+            Bullet->XForm.Scale = 0.2f;
+            Bullet->XForm.Rotation = 0;
+            Bullet->CollisionRadius = Bullet->XForm.Scale * 0.2;
+            Bullet->RelativeDrawCenter = vec2 {0.5f, 0.5f};
+            
+            Bullet->bullet.Damage = (Player->player.Power / 20) + 1;
+            Bullet->bullet.Damage = MIN(Bullet->bullet.Damage, 3);
+            
+            State->BulletSpawnCooldown += 0.05f;
+            SnapshotXForm(Bullet);
+            
+            //                        Mix_PlayChannel(0, sfxShoot, 0);
         }
     }
     
     if(WasPressed(GameInput.BombKey)) {                       
-        if (State->Player->player.Bombs > 0) {
-            
-            entity *Bomb = NextEntity(Entities);
-            
-            if (Bomb != NULL) {
-                Bomb->XForm.Pos = State->Player->XForm.Pos;
-                Bomb->CollisionRadius = 0.1f;
-                Bomb->XForm.Scale = Bomb->CollisionRadius * 3.0f / (State->Assets.BombTexture.Height * Default_World_Units_Per_Texel);
-                Bomb->XForm.Rotation = 0;
-                Bomb->Type = Entity_Type_Bomb;
-                Bomb->CollisionTypeMask = FLAG(Entity_Type_Boss) | FLAG(Entity_Type_Fly) | FLAG(Entity_Type_Bullet);
-                Bomb->RelativeDrawCenter = vec2 {0.5f, 0.5f};
-                
-                State->Player->player.Bombs--;
-                
+        if (Player->player.Bombs > 0) {
+            
+            entity *Bomb = NextEntity(Entities, Entity_Type_Bomb);
+            Bomb->XForm.Pos = Player->XForm.Pos;
+            Bomb->CollisionRadius = 0.1f;
+            Bomb->XForm.Scale = Bomb->CollisionRadius * 3.0f;
+            Bomb->XForm.Rotation = 0;
+            Bomb->RelativeDrawCenter = vec2 {0.5f, 0.5f};
+            SnapshotXForm(Bomb);
+            
+            Player->player.Bombs--;
+            
+            if (!State->IsHeadless)
                 Mix_PlayChannel(0, State->Assets.SfxBomb, 0);
-            }
         }
     }
+}
+
+void RenderGame(game_state *State, ui_context *Ui, font *Font, f32 InterpolationAlpha) {
+    PROFILE_FUNCTION();
     
-    
-    // render
+    auto Player = GetPlayer(State);
+    entity_cold *BossCold;
+    entity *Boss = FindBoss(&State->Entities, &BossCold);
     
 #if 0
     //background
@@ -1520,12 +3520,12 @@ void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *
     drawTexturedQuad(State.Camera, backgroundXForm, levelLayer2, White_Color, vec2 {0.5f,  currentLevelYPosition / State.Level.WorldHeight}, State.Level.LayersWorldUnitsPerPixels[1], 0.8f);
 #endif
     
-    DrawAllEntities(State);
+    DrawAllEntities(State, InterpolationAlpha);
     
     //GUI
     {
         //bomb count           
-        for (int Bomb = 0; Bomb < State->Player->player.Bombs; Bomb++){
+        for (int Bomb = 0; Bomb < Player->player.Bombs; Bomb++){
             UiTexturedRectangle(Ui, State->Assets.BombCountTexture, 20 + Bomb * (State->Assets.BombCountTexture.Width + 5), Ui->Height - 250, State->Assets.BombCountTexture.Width, State->Assets.BombCountTexture.Height, 0, 0, State->Assets.BombCountTexture.Width, State->Assets.BombCountTexture.Height, White_Color);
         }
         
@@ -1533,15 +3533,406 @@ void UpdateGame(game_state *State, input GameInput, ui_context *Ui, ui_control *
         if (Boss) {
             auto Cursor = UiBeginText(Ui, Font, 20, Ui->Height - 90);
             UiWrite(&Cursor, "BOSS ");
-            UiWrite(&Cursor, "Hp: %i / %i", Boss->Hp, Boss->MaxHp);
+            UiWrite(&Cursor, "Hp: %i / %i", BossCold->Hp, BossCold->MaxHp);
             
-            UiBar(Ui, 20, Ui->Height - 60, Ui->Width - 40, 40, Boss->Hp / (f32) Boss->MaxHp, color{1.0f, 0.0f, 0.0f, 1.0f}, color{0.0f, 1.0f, 0.0f, 1.0f});
+            UiBar(Ui, 20, Ui->Height - 60, Ui->Width - 40, 40, BossCold->Hp / (f32) BossCold->MaxHp, color{1.0f, 0.0f, 0.0f, 1.0f}, color{0.0f, 1.0f, 0.0f, 1.0f});
         }
         
         //player Power
-        UiBar(Ui, 20, Ui->Height - 200, 120,40, (State->Player->player.Power % 20) / 20.0f, color{1.0f, 0.0f, 0.0f, 1.0f}, color{0.0f, 1.0f, 0.0f, 1.0f});
+        UiBar(Ui, 20, Ui->Height - 200, 120,40, (Player->player.Power % 20) / 20.0f, color{1.0f, 0.0f, 0.0f, 1.0f}, color{0.0f, 1.0f, 0.0f, 1.0f});
+        
+#ifdef STRESS_TEST
+        auto Cursor = UiBeginText(Ui, Font, 20, 60, true, Orange_Color);
+#ifdef SIMD_COLLISION
+        UiWrite(&Cursor, "broadphase (simd x%u): %.3f ms (%u collisions)\n", Simd_Width, State->Stress.CollisionMilliseconds, State->Stress.CollisionCount);
+#else
+        UiWrite(&Cursor, "broadphase: %.3f ms (%u collisions)\n", State->Stress.CollisionMilliseconds, State->Stress.CollisionCount);
+#endif
+        UiWrite(&Cursor, "brute force: %.3f ms (%u collisions)", State->Stress.BruteForceMilliseconds, State->Stress.BruteForceCollisionCount);
+#endif
+    }
+}
+
+// fnv-1a over the simulated state of all live entities,
+// used to check that a replay ends up where the recording did
+u32 GameStateChecksum(game_state *State) {
+    u32 Hash = 2166136261u;
+    
+    auto Entities = &State->Entities;
+    for (u32 i = 0; i < Entities->Count; i++) {
+        auto Entity = EntityAt(Entities, i);
+        
+        u32 Values[] = {
+            (u32) Entity->Type,
+            (u32) ColdAt(Entities, i)->Hp,
+        };
+        
+        u8 *Bytes[] = { (u8 *) &Entity->XForm, (u8 *) Values };
+        u32 ByteCounts[] = { sizeof(Entity->XForm), sizeof(Values) };
+        
+        for (u32 Part = 0; Part < ARRAY_COUNT(Bytes); Part++) {
+            for (u32 b = 0; b < ByteCounts[Part]; b++) {
+                Hash ^= Bytes[Part][b];
+                Hash *= 16777619u;
+            }
+        }
+    }
+    
+    return Hash;
+}
+
+// runs one simulation step, while recording the input is stored,
+// while playing back the input is replaced by the recorded one
+void StepGame(game_state *State, input Input) {
+    auto Replay = &State->Replay;
+    
+    switch (Replay->Mode) {
+        case Replay_Mode_Record: {
+            RecordInput(Replay, Input);
+        } break;
+        
+        case Replay_Mode_Play: {
+            if (!NextReplayInput(Replay, &Input)) {
+                u32 Checksum = GameStateChecksum(State);
+                printf("replay %s finished after %u ticks, checksum %08x (recorded %08x)%s\n", Replay->FileName, Replay->TickCount, Checksum, Replay->Checksum, (Checksum == Replay->Checksum) ? "" : " DESYNC");
+                Replay->Mode = Replay_Mode_None;
+            }
+        } break;
+        
+        case Replay_Mode_None: {
+        } break;
+    }
+    
+    // several steps can run in one frame and headless runs have no frames,
+    // so the frame arena memory of a step is freed right after it
+    auto StepMemory = BeginTemporaryMemory(&Global_Frame_Arena);
+    UpdateGame(State, Input, Sim_Delta_Seconds);
+    EndTemporaryMemory(StepMemory);
+    
+    // a recording covers one run, it ends when we leave the game
+    if ((Replay->Mode == Replay_Mode_Record) && (State->Mode != Mode_Game)) {
+        Replay->Checksum = GameStateChecksum(State);
+        SaveReplay(Replay);
+        Replay->Mode = Replay_Mode_None;
+    }
+}
+
+// runs as many fixed simulation steps as fit into the passed time.
+// key changes are kept in SimInput until a step has seen them, so a press
+// is neither lost on frames without a step nor repeated on frames with several.
+// returns the interpolation alpha for RenderGame
+f32 AdvanceGame(game_state *State, input *SimInput, f32 DeltaSeconds) {
+    PROFILE_FUNCTION();
+    
+    State->SimAccumulator = MIN(State->SimAccumulator + DeltaSeconds, Max_Sim_Catch_Up_Seconds);
+    
+    while ((State->Mode == Mode_Game) && (State->SimAccumulator >= Sim_Delta_Seconds)) {
+        StepGame(State, *SimInput);
+        State->SimAccumulator -= Sim_Delta_Seconds;
+        
+        for (u32 i = 0; i < ARRAY_COUNT(SimInput->Keys); i++) {
+            SimInput->Keys[i].HasChanged = false;
+        }
+    }
+    
+    return State->SimAccumulator / Sim_Delta_Seconds;
+}
+
+void SetKey(key *Key, bool IsPressed) {
+    Key->HasChanged = (Key->IsPressed != IsPressed);
+    Key->IsPressed = IsPressed;
+}
+
+// fires all the time, strafes left and right and bombs every 10 seconds
+void ScriptedInput(input *Input, u32 Tick) {
+    f32 Seconds = Tick * Sim_Delta_Seconds;
+    bool StrafeLeft = ((u32)(Seconds / 2.0f) % 2) == 0;
+    
+    SetKey(&Input->FireKey, true);
+    SetKey(&Input->LeftKey, StrafeLeft);
+    SetKey(&Input->RightKey, !StrafeLeft);
+    SetKey(&Input->BombKey, (Tick % (u32)(10.0f / Sim_Delta_Seconds)) == 0);
+}
+
+// simulates a level with UpdateGame as fast as possible, without window, gl or audio.
+// usage: -headless <level file> [seconds] [-seed n] [-replay file] [-trace file]
+// seconds defaults to the level duration, the level restarts whenever the player dies.
+// with -replay the recorded input and seed are used instead of the scripted input
+// and the run stops with the recording.
+// with ALLOCATION_TRACKING every tick is a frame, the exit code is 1 if a tick
+// after the warmup allocated.
+s32 RunHeadless(s32 ArgCount, char **Args) {
+    if (ArgCount < 1) {
+        printf("usage: -headless <level file> [seconds] [-seed n] [-replay file] [-trace file]\n");
+        return 1;
+    }
+    
+    SDL_Init(0);
+    
+    // game_state is too big for the stack
+    game_state *State = new game_state();
+    State->IsHeadless = true;
+    
+    f32 Seconds = -1.0f;
+    char *TraceFileName = NULL;
+    
+    for (s32 i = 1; i < ArgCount; i++) {
+        if ((strcmp(Args[i], "-seed") == 0) && (i + 1 < ArgCount)) {
+            State->Seed = strtoull(Args[++i], NULL, 10);
+        }
+        else if ((strcmp(Args[i], "-replay") == 0) && (i + 1 < ArgCount)) {
+            if (!LoadReplay(&State->Replay, Args[++i]))
+                return 1;
+            
+            State->Seed = State->Replay.Seed;
+        }
+        else if ((strcmp(Args[i], "-trace") == 0) && (i + 1 < ArgCount)) {
+            TraceFileName = Args[++i];
+        }
+        else {
+            Seconds = atof(Args[i]);
+        }
+    }
+    
+    State->WorldWidth = WorldCameraHeight / WorldHeightOverWidth;
+    State->Mode = Mode_Game;
+    State->Level = LoadLevel(Args[0]);
+    if (State->Level.LoadFailed)
+        return 1;
+    
+    Init(&State->Broadphase);
+    
+    initGame(State);
+    
+    if (Seconds < 0.0f)
+        Seconds = State->Level.Duration;
+    
+    u32 TickCount = (u32) ceilf(Seconds / Sim_Delta_Seconds);
+    
+    bool IsReplay = (State->Replay.Mode == Replay_Mode_Play);
+    if (IsReplay)
+        TickCount = State->Replay.TickCount;
+    u32 DeathCount = 0;
+    u32 MaxEntityCount = 0;
+    
+    input Input = {};
+    
+    u64 StartTime = SDL_GetPerformanceCounter();
+    
+    for (u32 Tick = 0; Tick < TickCount; Tick++) {
+        if (!IsReplay)
+            ScriptedInput(&Input, Tick);
+        
+        ALLOCATION_TRACKING_BEGIN_FRAME();
+        StepGame(State, Input);
+        ResetArena(&Global_Frame_Arena);
+        ALLOCATION_TRACKING_END_FRAME();
+        
+        MaxEntityCount = MAX(MaxEntityCount, State->Entities.Count);
+        
+        if (State->Mode != Mode_Game) {
+            if (IsReplay)
+                break;
+            
+            DeathCount++;
+            initGame(State);
+            State->Mode = Mode_Game;
+        }
+    }
+    
+    f64 WallSeconds = (SDL_GetPerformanceCounter() - StartTime) / (f64) SDL_GetPerformanceFrequency();
+    
+    printf("level:            %s\n", Args[0]);
+    printf("simulated:        %.2f s (%u ticks at %.0f Hz)\n", TickCount * Sim_Delta_Seconds, TickCount, 1.0f / Sim_Delta_Seconds);
+    printf("wall time:        %.3f s\n", WallSeconds);
+    printf("ticks per second: %.0f (%.1fx real time)\n", TickCount / WallSeconds, (TickCount * Sim_Delta_Seconds) / WallSeconds);
+    printf("deaths:           %u\n", DeathCount);
+    printf("max entities:     %u\n", MaxEntityCount);
+    printf("seed:             %llu\n", (unsigned long long) State->Seed);
+    printf("checksum:         %08x\n", GameStateChecksum(State));
+    printf("frame arena:      %.1f kb high water, %u overflows\n", Global_Frame_Arena.HighWaterMark / 1024.0, Global_Frame_Arena.OverflowCount);
+    printf("collisions:       %llu pairs, %llu consumed, %u max per tick\n", (unsigned long long) State->CollisionStats.TotalPairCount, (unsigned long long) State->CollisionStats.TotalConsumedCount, State->CollisionStats.MaxPairCount);
+    
+    // the loop stops at the recorded tick count, so StepGame never sees the replay end
+    bool IsDesync = false;
+    if (IsReplay) {
+        u32 Checksum = GameStateChecksum(State);
+        IsDesync = (Checksum != State->Replay.Checksum);
+        printf("replay:           %s, checksum %08x, recorded %08x%s\n", State->Replay.FileName, Checksum, State->Replay.Checksum, IsDesync ? " DESYNC" : "");
+    }
+    
+#if defined PROFILER
+    if (TraceFileName)
+        ProfileWriteChromeTrace(TraceFileName);
+#else
+    if (TraceFileName)
+        printf("-trace needs a build with PROFILER\n");
+#endif
+    
+    SDL_Quit();
+    
+#if defined ALLOCATION_TRACKING
+    printf("loop allocations: %u in %u ticks\n", Global_Allocation_Tracker.LoopAllocationCount, Global_Allocation_Tracker.AllocatingFrameCount);
+    
+    if (Global_Allocation_Tracker.LoopAllocationCount > 0)
+        return 1;
+#endif
+    
+    if (IsDesync)
+        return 1;
+    
+    return 0;
+}
+
+// times UpdateFlyPosition for every path type, once at the start of a level and once
+// an hour into it. looping paths should cost the same at both.
+// also prints how far the baked trajectory is off the path.
+// usage: -benchmark-paths [steps]
+s32 RunPathBenchmark(s32 ArgCount, char **Args) {
+    SDL_Init(0);
+    
+    u32 StepCount = 1000000;
+    if (ArgCount >= 1)
+        StepCount = atoi(Args[0]);
+    
+    level Level = {};
+    
+    entity Fly = {};
+    Fly.Type = Entity_Type_Fly;
+    
+    path Points = {};
+    for (u32 i = 0; i < 10; i++) {
+        auto Point = PushPathPoint(&Level, &Points);
+        Point->Position = { cosf(i * 0.7f), sinf(i * 0.7f) };
+        Point->Time = i * 0.5f;
+    }
+    
+    // spawn info 0, followed by one info per benchmark and the chain
+    auto Leader = PushSpawnInfo(&Level);
+    Leader->Blueprint = Fly;
+    Leader->Path = Points;
+    Leader->Path.Type = Path_Type_Loop;
+    Leader->Path.TransitionTime = 1.0f;
+    BakeTrajectory(&Level, &Leader->Path);
+    
+    struct path_benchmark {
+        const char *Name;
+        path_type Type;
+        path_curve Curve;
+    };
+    
+    path_benchmark Benchmarks[] = {
+        { "stop",        Path_Type_Stop,    Path_Curve_Linear },
+        { "loop",        Path_Type_Loop,    Path_Curve_Linear },
+        { "reverse",     Path_Type_Reverse, Path_Curve_Linear },
+        { "follow",      Path_Type_Follow,  Path_Curve_Linear },
+        { "catmull rom", Path_Type_Loop,    Path_Curve_Catmull_Rom },
+        { "bezier",      Path_Type_Loop,    Path_Curve_Bezier },
+    };
+    
+    f32 StartTimes[] = { 0.0f, 3600.0f };
+    f64 CounterToNanoseconds = 1000000000.0 / SDL_GetPerformanceFrequency();
+    
+    printf("%u steps of %.2f ms\n", StepCount, Sim_Delta_Seconds * 1000.0f);
+    printf("%-12s %16s %16s %16s\n", "path", "ns/step at 0s", "ns/step at 3600s", "max error");
+    
+    for (u32 BenchmarkIndex = 0; BenchmarkIndex < ARRAY_COUNT(Benchmarks); BenchmarkIndex++) {
+        auto Benchmark = Benchmarks + BenchmarkIndex;
+        f64 Nanoseconds[ARRAY_COUNT(StartTimes)];
+        f32 MaxError = 0.0f;
+        
+        u32 InfoIndex = (u32) Level.SpawnInfos.Count;
+        auto Info = PushSpawnInfo(&Level);
+        Info->Blueprint = Fly;
+        Info->Path = Points;
+        Info->Path.Type = Benchmark->Type;
+        Info->Path.Curve = Benchmark->Curve;
+        Info->Path.TransitionTime = 1.0f;
+        
+        if (Benchmark->Type == Path_Type_Follow) {
+            Info->Path.TransitionTime = 0.25f;
+            SetFollowing(&Level, InfoIndex, 1);
+        }
+        
+        BakeTrajectory(&Level, &Info->Path);
+        
+        entity Entity = Fly;
+        Entity.fly.SpawnInfo = InfoIndex + 1;
+        
+        for (u32 StartIndex = 0; StartIndex < ARRAY_COUNT(StartTimes); StartIndex++) {
+            // keeps the compiler from dropping the calls
+            vec2 Sum = {};
+            
+            u64 StartTime = SDL_GetPerformanceCounter();
+            
+            for (u32 Step = 0; Step < StepCount; Step++) {
+                UpdateFlyPosition(&Level, &Entity, StartTimes[StartIndex] + Step * Sim_Delta_Seconds);
+                Sum = Sum + Entity.XForm.Pos;
+            }
+            
+            Nanoseconds[StartIndex] = (SDL_GetPerformanceCounter() - StartTime) * CounterToNanoseconds / StepCount;
+            
+            if (Sum.X == FLT_MAX)
+                printf("\n");
+            
+            if (Benchmark->Type != Path_Type_Follow) {
+                path_cursor Cursor = {};
+                
+                for (u32 Step = 0; Step < MIN(StepCount, 10000u); Step++) {
+                    f32 Time = StartTimes[StartIndex] + Step * Sim_Delta_Seconds;
+                    vec2 Baked = TrajectoryPosition(&Level, &Info->Path.Trajectory, Time, {});
+                    vec2 Exact = FlyPathPosition(&Level, &Info->Path, Time, &Cursor, {});
+                    
+                    MaxError = MAX(MaxError, length(Baked - Exact));
+                }
+            }
+        }
+        
+        printf("%-12s %16.1f %16.1f %16f\n", Benchmark->Name, Nanoseconds[0], Nanoseconds[1], MaxError);
+    }
+    
+    // a snake of flies each following the one before
+    {
+        const u32 Chain_Length = 64;
+        
+        entity Chain[Chain_Length];
+        Chain[0] = Fly;
+        Chain[0].fly.SpawnInfo = 1;
+        
+        for (u32 i = 1; i < Chain_Length; i++) {
+            u32 InfoIndex = (u32) Level.SpawnInfos.Count;
+            auto Info = PushSpawnInfo(&Level);
+            Info->Blueprint = Fly;
+            Info->Path.Type = Path_Type_Follow;
+            Info->Path.TransitionTime = 0.1f;
+            SetFollowing(&Level, InfoIndex, Chain[i - 1].fly.SpawnInfo);
+            
+            Chain[i] = Fly;
+            Chain[i].fly.SpawnInfo = InfoIndex + 1;
+        }
+        
+        u32 ChainStepCount = MAX(StepCount / Chain_Length, 1u);
+        vec2 Sum = {};
+        u64 StartTime = SDL_GetPerformanceCounter();
+        
+        for (u32 Step = 0; Step < ChainStepCount; Step++) {
+            for (u32 i = 0; i < Chain_Length; i++) {
+                UpdateFlyPosition(&Level, Chain + i, 3600.0f + Step * Sim_Delta_Seconds);
+                Sum = Sum + Chain[i].XForm.Pos;
+            }
+        }
+        
+        f64 Nanoseconds = (SDL_GetPerformanceCounter() - StartTime) * CounterToNanoseconds / (ChainStepCount * Chain_Length);
+        printf("chain of %u: %.1f ns per fly\n", Chain_Length, Nanoseconds);
+        
+        if (Sum.X == FLT_MAX)
+            printf("\n");
     }
+    
+    SDL_Quit();
+    return 0;
 }
+
 // gl functions
 
 PFNGLDEBUGMESSAGECALLBACKPROC glDebugMessageCallback = NULL;
@@ -1549,7 +3940,7 @@ PFNGLDEBUGMESSAGECALLBACKPROC glDebugMessageCallback = NULL;
 void APIENTRY
 wostenGLDebugCallback(GLenum source, GLenum Type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void * user_param)
 {
-    char *severity_text = NULL;
+    const char *severity_text = NULL;
     switch (severity)
     {
         case GL_DEBUG_SEVERITY_HIGH:
@@ -1572,7 +3963,7 @@ wostenGLDebugCallback(GLenum source, GLenum Type, GLuint id, GLenum severity, GL
         severity_text = "unkown severity";
     }
     
-    char *type_text = NULL;
+    const char *type_text = NULL;
     switch (Type)
     {
         case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
@@ -1619,7 +4010,24 @@ wostenGLDebugCallback(GLenum source, GLenum Type, GLuint id, GLenum severity, GL
 }	
 
 int main(int argc, char* argv[]) {
-    srand (time(NULL));
+    ALLOCATION_TRACKING_INIT();
+    
+    if ((argc >= 2) && (strcmp(argv[1], "-headless") == 0))
+        return RunHeadless(argc - 2, argv + 2);
+    
+    if ((argc >= 2) && (strcmp(argv[1], "-benchmark-paths") == 0))
+        return RunPathBenchmark(argc - 2, argv + 2);
+    
+    // -record <file> stores the input of the next run, -replay <file> plays it back
+    char *RecordFileName = NULL;
+    char *ReplayFileName = NULL;
+    
+    for (s32 i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-record") == 0)
+            RecordFileName = argv[++i];
+        else if (strcmp(argv[i], "-replay") == 0)
+            ReplayFileName = argv[++i];
+    }
     
     SDL_Window *Window;                                     // Declare a pointer
     
@@ -1660,6 +4068,8 @@ int main(int argc, char* argv[]) {
         glDebugMessageCallback(wostenGLDebugCallback, NULL);
     }    
     
+    Init(&Global_Sprite_Batch);
+    
     histogram FrameRateHistogram = {};
     
     ui_context Ui;
@@ -1673,8 +4083,16 @@ int main(int argc, char* argv[]) {
     u64 LastTime = SDL_GetPerformanceCounter();
     f32 ScaleAlpha = 0;
     
-    entity _entitieEntries[100];
     game_state State = {};
+    State.Seed = (u64) time(NULL);
+    
+    if (ReplayFileName && LoadReplay(&State.Replay, ReplayFileName))
+        State.Seed = State.Replay.Seed;
+    else if (RecordFileName)
+        StartRecording(&State.Replay, RecordFileName, State.Seed);
+    
+    State.Random.Effects = MakeRandomSeries(State.Seed, 3);
+    
     State.WorldWidth = WorldCameraHeight / WorldHeightOverWidth;
     State.Mode = Mode_Title;
     State.Level.Duration = 30.0f;
@@ -1682,30 +4100,36 @@ int main(int argc, char* argv[]) {
     State.Level.LayersWorldUnitsPerPixels[0] = State.WorldWidth / State.Assets.LevelLayer1.Width;
     State.Level.LayersWorldUnitsPerPixels[1] = State.WorldWidth / State.Assets.LevelLayer2.Width;
     State.Level.WorldHeight = State.Level.LayersWorldUnitsPerPixels[0] * State.Assets.LevelLayer1.Height;  
-    State.Entities = { ARRAY_WITH_COUNT(_entitieEntries) };
+    Init(&State.Broadphase);
     State.Editor.DeleteButtonSelected = false;
     
     State.Assets.LevelLayer1 = LoadTexture("data/level_1.png");
     State.Assets.LevelLayer2 = LoadTexture("data/level_1_layer_2.png");
-    State.Assets.PlayerTexture = LoadTexture("data/Kenney/Animals/giraffe.png");
-    State.Assets.BossTexture = LoadTexture("data/Kenney/Animals/parrot.png");
-    State.Assets.FlyTexture = LoadTexture("data/Kenney/Animals/chicken.png");
-    State.Assets.BulletTexture = LoadTexture("data/Kenney/Missiles/spaceMissiles_014.png");  
-    State.Assets.BulletPoweredUpTexture = LoadTexture("data/Kenney/Missiles/spaceMissiles_001.png");
-    State.Assets.BulletMaxPoweredUpTexture = LoadTexture("data/Kenney/Missiles/spaceMissiles_006.png");
-    State.Assets.BombTexture = LoadTexture("data/Kenney/particlePackCircle.png");
-    State.Assets.PowerupTexture = LoadTexture("data/Kenney/Letter Tiles/letter_P.png");
     
-    // UI
-    State.Assets.BombCountTexture = LoadTexture("data/Kenney/Missiles/spaceMissiles_021.png");
-    State.Assets.IdleButtonTexture = LoadTexture("data/Kenney/PNG/blue_button02.png");
-    State.Assets.HotButtonTexture = LoadTexture("data/Kenney/PNG/blue_button03.png");
-    State.Assets.DeleteButtonTexture = LoadTexture("data/Kenney/PNG/grey_boxCross.png");
-    State.Assets.AddPathButtonTexture = LoadTexture("data/Kenney/PNG/blue_boxTick.png");
-    State.Assets.PathStopButtonTexture = LoadTexture("data/icons8/icons8-pause-64.png");
-    State.Assets.PathLoopButtonTexture = LoadTexture("data/icons8/icons8-replay-64.png");
-    State.Assets.PathReverseButtonTexture = LoadTexture("data/icons8/icons8-rewind-64.png");
-    State.Assets.PathFollowButtonTexture = LoadTexture("data/Kenney/followPath.png");
+    // the level layers are too big, everything else goes into atlases
+    atlas_image AtlasImages[] = {
+        { "data/Kenney/Animals/giraffe.png",              &State.Assets.PlayerTexture },
+        { "data/Kenney/Animals/parrot.png",               &State.Assets.BossTexture },
+        { "data/Kenney/Animals/chicken.png",              &State.Assets.FlyTexture },
+        { "data/Kenney/Missiles/spaceMissiles_014.png",   &State.Assets.BulletTexture },
+        { "data/Kenney/Missiles/spaceMissiles_001.png",   &State.Assets.BulletPoweredUpTexture },
+        { "data/Kenney/Missiles/spaceMissiles_006.png",   &State.Assets.BulletMaxPoweredUpTexture },
+        { "data/Kenney/particlePackCircle.png",           &State.Assets.BombTexture },
+        { "data/Kenney/Letter Tiles/letter_P.png",        &State.Assets.PowerupTexture },
+        
+        // UI
+        { "data/Kenney/Missiles/spaceMissiles_021.png",   &State.Assets.BombCountTexture },
+        { "data/Kenney/PNG/blue_button02.png",            &State.Assets.IdleButtonTexture },
+        { "data/Kenney/PNG/blue_button03.png",            &State.Assets.HotButtonTexture },
+        { "data/Kenney/PNG/grey_boxCross.png",            &State.Assets.DeleteButtonTexture },
+        { "data/Kenney/PNG/blue_boxTick.png",             &State.Assets.AddPathButtonTexture },
+        { "data/icons8/icons8-pause-64.png",              &State.Assets.PathStopButtonTexture },
+        { "data/icons8/icons8-replay-64.png",             &State.Assets.PathLoopButtonTexture },
+        { "data/icons8/icons8-rewind-64.png",             &State.Assets.PathReverseButtonTexture },
+        { "data/Kenney/followPath.png",                   &State.Assets.PathFollowButtonTexture },
+    };
+    
+    State.Assets.AtlasCount = LoadTextureAtlases(ARRAY_WITH_COUNT(AtlasImages));
     { 
         SDL_RWops* Op = SDL_RWFromFile("C:/Windows/Fonts/Arial.ttf", "rb");
         s64 ByteCount = Op->size(Op);
@@ -1773,7 +4197,7 @@ int main(int argc, char* argv[]) {
     
     //sound init
     int MixInit = Mix_Init(MIX_INIT_MP3);
-    if(MixInit&MIX_INIT_MP3 != MIX_INIT_MP3) {
+    if ((MixInit & MIX_INIT_MP3) != MIX_INIT_MP3) {
         printf("Error initializing mix: %s \n", Mix_GetError());
     }
     
@@ -1810,36 +4234,54 @@ int main(int argc, char* argv[]) {
     
     State.Level = LoadLevel("data/levels/Level.bin");
     
+    // never replace a level we couldn't read, the editor saves next to it instead
+    const char *LevelFileName = "data/levels/Level.bin";
+    if (State.Level.LoadFailed) {
+        LevelFileName = "data/levels/LevelNew.bin";
+        printf("data/levels/Level.bin is kept as it is, the level is saved to %s\n", LevelFileName);
+    }
+    
 #if defined WIN32
 	if (!CreateDirectoryA("data/levels", NULL))
 	{
 		SDL_assert_release(GetLastError() == ERROR_ALREADY_EXISTS);
 	}
 #else
-    #  #error Platform not supported 
+    mkdir("data/levels", 0755);
 #endif
     
-        SaveLevel("data/levels/LevelBackup.bin", State.Level);
+    if (!State.Level.LoadFailed)
+        SaveLevel("data/levels/LevelBackup.bin", &State.Level);
     
-    RestoreFollowingPointer(&State.Level.SpawnInfos);
     initGame(&State);
     
     input GameInput = {};
+    input SimInput = {};
     
     
     //game loop   
     while (DoContinue) {
+        PROFILE_SCOPE("frame");
+        ALLOCATION_TRACKING_BEGIN_FRAME();
+        
         for (s32 i = 0; i < ARRAY_COUNT(GameInput.Keys); i++) {
             GameInput.Keys[i].HasChanged = false;
         }
         
+        PROFILE_BEGIN("events");
+        
         //window events 
         SDL_Event Event;
         while (SDL_PollEvent(&Event)) {
             switch (Event.type) {
                 case SDL_QUIT:{
                     DoContinue = false;
-                    SaveLevel("data/levels/Level.bin", State.Level);
+                    SaveLevel(LevelFileName, &State.Level);
+                    
+                    if (State.Replay.Mode == Replay_Mode_Record) {
+                        State.Replay.Checksum = GameStateChecksum(&State);
+                        SaveReplay(&State.Replay);
+                    }
                     
                     SaveConfig("data/config.bin", Window);
                     
@@ -1929,10 +4371,18 @@ int main(int argc, char* argv[]) {
                             GameInput.ToggleEditModeKey.IsPressed = (Event.key.type == SDL_KEYDOWN);
                             GameInput.ToggleEditModeKey.HasChanged = true;
                         } break;
+                        
+#if defined PROFILER
+                        case SDL_SCANCODE_F2: {
+                            if (Event.key.type == SDL_KEYDOWN)
+                                ProfileWriteChromeTrace("profile_trace.json");
+                        } break;
+#endif
                     }
                 } break;
             }
         }
+        PROFILE_END();
         
         {
             s32 WX, WY;
@@ -1989,6 +4439,7 @@ int main(int argc, char* argv[]) {
         }
         
         //game update
+        PROFILE_BEGIN("update");
         switch (State.Mode) {
             case Mode_Title: {
                 UpdateTitle(&State, &Ui, &UiControl, DefaultFont, DeltaSeconds, GameInput, &DoContinue);   
@@ -2003,7 +4454,17 @@ int main(int argc, char* argv[]) {
                     State.Mode = Mode_Editor;
                     break;
                 };
-                UpdateGame(&State, GameInput, &Ui, &UiControl, DefaultFont, DeltaSeconds);
+                
+                for (u32 i = 0; i < ARRAY_COUNT(SimInput.Keys); i++) {
+                    SimInput.Keys[i].IsPressed   = GameInput.Keys[i].IsPressed;
+                    SimInput.Keys[i].HasChanged |= GameInput.Keys[i].HasChanged;
+                }
+                SimInput.MousePos = GameInput.MousePos;
+                
+                f32 InterpolationAlpha = AdvanceGame(&State, &SimInput, DeltaSeconds);
+                
+                if (State.Mode == Mode_Game)
+                    RenderGame(&State, &Ui, DefaultFont, InterpolationAlpha);
             } break;
             
             case Mode_Game_Over: {
@@ -2022,6 +4483,7 @@ int main(int argc, char* argv[]) {
                 assert(0);
             } break;
         }            
+        PROFILE_END();
         
         //debug framerate, hitbox and player/boss normalized x, y coordinates
 #ifdef DEBUG_UI
@@ -2033,12 +4495,17 @@ int main(int argc, char* argv[]) {
             auto Cursor = UiBeginText(&Ui, DefaultFont, 10, Ui.Height / 2, true, color{1.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
             //UiWrite(&Cursor, "mouse Pos: %f, %f [%i, %i]\n", UiControl.Cursor.X, UiControl.Cursor.Y, GameInput.LeftMouseKey.IsPressed, GameInput.LeftMouseKey.HasChanged);            
             //UiWrite(&Cursor, "UiControl: [active: %llu, hot: %llu]\n", UiControl.ActiveId, UiControl.HotId);
-            UiWrite(&Cursor, "Entities: [%llu / %llu] \n", State.Entities.Count, State.Entities.Capacity);
+            UiWrite(&Cursor, "Entities: [%u / %u] \n", State.Entities.Count, Capacity(&State.Entities));
+            UiWrite(&Cursor, "Sprites: %u in %u draw calls, %u atlases\n", Global_Sprite_Batch.Stats.QuadCount, Global_Sprite_Batch.Stats.DrawCallCount, State.Assets.AtlasCount);
+            UiWrite(&Cursor, "Ui: %u commands in %u draw calls\n", Ui.Stats.CommandCount, Ui.Stats.DrawCallCount);
+            UiWrite(&Cursor, "Frame arena: %.1f kb, %.1f kb high water, %u overflows\n", Global_Frame_Arena.LastUsed / 1024.0, Global_Frame_Arena.HighWaterMark / 1024.0, Global_Frame_Arena.OverflowCount);
+            UiWrite(&Cursor, "Collisions: %u pairs, %u consumed, %u max\n", State.CollisionStats.PairCount, State.CollisionStats.ConsumedCount, State.CollisionStats.MaxPairCount);
         }           
         
         //UiRectangle(&Ui, UiControl.Cursor.X - 10, UiControl.Cursor.Y - 10, 20, 20, color { 1.0f, 0, 0, 1.0f });
         
         UiRenderCommands(&Ui);
+        ResetSpriteStats(&Global_Sprite_Batch);
         
         // render end
         
@@ -2047,7 +4514,12 @@ int main(int argc, char* argv[]) {
             printf("gl error:%d \n", glError);
         }
         
+        PROFILE_BEGIN("swap");
         SDL_GL_SwapWindow(Window);   
+        PROFILE_END();
+        
+        ResetArena(&Global_Frame_Arena);
+        ALLOCATION_TRACKING_END_FRAME();
     }
     // Close and destroy the window
     SDL_DestroyWindow(Window);
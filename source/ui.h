@@ -40,10 +40,39 @@ struct ui_draw_command
 #define template_array_is_buffer 
 #include "template_array.h"
 
+// consecutive commands with the same primitive and texture are drawn together
+struct ui_draw_run
+{
+    GLenum Primitive;
+    GLuint Texture; // 0 for untextured
+    u32 FirstVertex, VertexCount;
+};
+
+#define template_array_name      ui_draw_runs
+#define template_array_data_type ui_draw_run
+#define template_array_is_buffer 
+#include "template_array.h"
+
+// a command needs at most 4 lines
+const u32 Ui_Max_Vertices_Per_Command = 8;
+
+// DrawCommands, Runs and Vertices live in the Global_Frame_Arena, so
+// UiRenderCommands has to run every frame before the arena is reset
 struct ui_context
 {
     ui_draw_commands DrawCommands;
     s32 Width, Height;
+    
+    ui_draw_runs Runs;
+    sprite_vertex *Vertices;
+    u32 VertexCount;
+    GLuint VertexBuffer;
+    
+    // of the last UiRenderCommands
+    struct {
+        u32 CommandCount;
+        u32 DrawCallCount;
+    } Stats;
 };
 
 struct ui_text_cursor {
@@ -58,10 +87,25 @@ struct ui_text_cursor {
     color Color;
 };
 
-void Init(ui_context *Context, u32 DrawCommandCount = 4096)
+void Init(ui_context *Context)
 {
     *Context = {};
-    Context->DrawCommands = { new ui_draw_command[DrawCommandCount], DrawCommandCount };
+}
+
+ui_draw_command *UiPushCommand(ui_context *Context) {
+    auto Commands = &Context->DrawCommands;
+    
+    // the old commands stay in the arena until the end of the frame
+    if (Commands->Count == Commands->Capacity) {
+        u32 NewCapacity = MAX(256, Commands->Capacity * 2);
+        auto NewBase = PUSH_ARRAY(&Global_Frame_Arena, ui_draw_command, NewCapacity);
+        memcpy(NewBase, Commands->Base, sizeof(ui_draw_command) * Commands->Count);
+        
+        Commands->Base = NewBase;
+        Commands->Capacity = NewCapacity;
+    }
+    
+    return Push(Commands);
 }
 
 vec2 UiToCanvasPoint(ui_context *Context, vec2 UiPoint){
@@ -81,9 +125,7 @@ vec2 CanvasToUiPoint(ui_context *Context, vec2 CanvasPoint){
 void
 UiTexturedRectangle(ui_context *Context, texture Texture, s32 X, s32 Y, s32 Width, s32 Height, s32 SubTextureX, s32 SubTextureY, s32 SubTextureWidth, s32 SubTextureHeight, color Color = White_Color)
 {
-    auto command = Push(&Context->DrawCommands);
-    if (!command)
-        return;
+    auto command = UiPushCommand(Context);
     
     command->Kind = Ui_Draw_Command_Textured_Rectangle;
     auto TexturedRectangle = &command->TexturedRectangle;
@@ -101,9 +143,7 @@ void UiTexturedRectangle(ui_context *Context, texture Texture, rect Rect, rect S
 void
 UiRectangle(ui_context *Context, s32 X, s32 Y, s32 Width, s32 Height, color Color = White_Color, bool IsFilled = true)
 {
-    auto command = Push(&Context->DrawCommands);
-    if (!command)
-        return;
+    auto command = UiPushCommand(Context);
     
     command->Kind = Ui_Draw_Command_Rectangle;
     auto Rectangle = &command->Rectangle;
@@ -118,16 +158,38 @@ UiRectangle(ui_context *Context, rect Rect, color Color = White_Color, bool IsFi
     UiRectangle(Context, Rect.Left, Rect.Bottom, Rect.Right - Rect.Left, Rect.Top - Rect.Bottom, Color, IsFilled);
 }
 
+void UiPushVertex(ui_context *Context, s32 X, s32 Y, vec2 UV, u32 Color) {
+    vec2 V = UiToCanvasPoint(Context, X, Y);
+    Context->Vertices[Context->VertexCount++] = { V.X, V.Y, -0.9f, UV.X, UV.Y, Color };
+}
+
+// starts a new run unless the last one has the same primitive and texture
+void UiExtendRun(ui_context *Context, GLenum Primitive, GLuint Texture, u32 VertexCount) {
+    if (Context->Runs.Count > 0) {
+        auto Last = &Context->Runs[Context->Runs.Count - 1];
+        
+        if ((Last->Primitive == Primitive) && (Last->Texture == Texture)) {
+            Last->VertexCount += VertexCount;
+            return;
+        }
+    }
+    
+    auto Run = Push(&Context->Runs);
+    assert(Run);
+    
+    *Run = { Primitive, Texture, Context->VertexCount, VertexCount };
+}
+
 void
 UiRenderCommands(ui_context *Context)
 {
-    glDisable(GL_DEPTH_TEST);
+    PROFILE_FUNCTION();
     
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glEnable(GL_ALPHA_TEST);
-    glAlphaFunc(GL_GEQUAL, 0.1f);
+    u32 CommandCount = Context->DrawCommands.Count;
+    Context->Runs.Base = PUSH_ARRAY(&Global_Frame_Arena, ui_draw_run, CommandCount);
+    Context->Runs.Count = CommandCount;
+    Context->Vertices = PUSH_ARRAY(&Global_Frame_Arena, sprite_vertex, CommandCount * Ui_Max_Vertices_Per_Command);
+    Context->VertexCount = 0;
     
     for (u32 i = 0; i < Context->DrawCommands.Count; i++)
     {
@@ -136,69 +198,45 @@ UiRenderCommands(ui_context *Context)
             case Ui_Draw_Command_Textured_Rectangle:
             {
                 auto TexturedRectangle = &Context->DrawCommands[i].TexturedRectangle;
+                auto Rectangle = TexturedRectangle->DrawRectangle;
+                auto SubRectangle = TexturedRectangle->TextureSubRectangle;
                 
-                glEnable(GL_TEXTURE_2D);
-                glBindTexture(GL_TEXTURE_2D, TexturedRectangle->Texture.Object);
-                
-                glColor4fv(TexturedRectangle->Color.Values);
-                
-                glBegin(GL_QUADS);
-                
-                vec2 UV = {
-                    TexturedRectangle->TextureSubRectangle.X / (f32) TexturedRectangle->Texture.Width,
-                    TexturedRectangle->TextureSubRectangle.Y / (f32) TexturedRectangle->Texture.Height,
-                };
+                vec2 UV = TextureUV(TexturedRectangle->Texture, SubRectangle.X, SubRectangle.Y);
+                vec2 UVSize = TextureUV(TexturedRectangle->Texture, SubRectangle.X + SubRectangle.Width, SubRectangle.Y + SubRectangle.Height) - UV;
+                u32 Color = PackColor(TexturedRectangle->Color);
                 
-                vec2 UVSize = {
-                    TexturedRectangle->TextureSubRectangle.Width / (f32) TexturedRectangle->Texture.Width,
-                    TexturedRectangle->TextureSubRectangle.Height / (f32) TexturedRectangle->Texture.Height,
-                };
-                
-                glTexCoord2f(UV.X, UV.Y);  	
-                vec2 v = UiToCanvasPoint(Context, TexturedRectangle->DrawRectangle.X, TexturedRectangle->DrawRectangle.Y);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                glTexCoord2f(UV.X + UVSize.X, UV.Y);  	
-                v = UiToCanvasPoint(Context, TexturedRectangle->DrawRectangle.X + TexturedRectangle->DrawRectangle.Width, TexturedRectangle->DrawRectangle.Y);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                glTexCoord2f(UV.X + UVSize.X, UV.Y + UVSize.Y);  	
-                v = UiToCanvasPoint(Context, TexturedRectangle->DrawRectangle.X + TexturedRectangle->DrawRectangle.Width, TexturedRectangle->DrawRectangle.Y + TexturedRectangle->DrawRectangle.Height);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                glTexCoord2f(UV.X, UV.Y + UVSize.Y);  	
-                v = UiToCanvasPoint(Context, TexturedRectangle->DrawRectangle.X, TexturedRectangle->DrawRectangle.Y + TexturedRectangle->DrawRectangle.Height);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                glEnd();
+                UiExtendRun(Context, GL_QUADS, TexturedRectangle->Texture.Object, 4);
+                UiPushVertex(Context, Rectangle.X,                   Rectangle.Y,                    UV, Color);
+                UiPushVertex(Context, Rectangle.X + Rectangle.Width, Rectangle.Y,                    vec2{ UV.X + UVSize.X, UV.Y }, Color);
+                UiPushVertex(Context, Rectangle.X + Rectangle.Width, Rectangle.Y + Rectangle.Height, UV + UVSize, Color);
+                UiPushVertex(Context, Rectangle.X,                   Rectangle.Y + Rectangle.Height, vec2{ UV.X, UV.Y + UVSize.Y }, Color);
             } break;
             
             case Ui_Draw_Command_Rectangle:
             {
-                auto Rectangle = &Context->DrawCommands[i].Rectangle;
-                
-                glDisable(GL_TEXTURE_2D);
-                
-                glColor4fv(Rectangle->Color.Values);
-                
-                if (Rectangle->IsFilled)
-                    glBegin(GL_QUADS);
-                else
-                    glBegin(GL_LINE_LOOP);
-                
-                vec2 v = UiToCanvasPoint(Context, Rectangle->DrawRectangle.X, Rectangle->DrawRectangle.Y);
-                glVertex3f(v.X, v.Y, -0.9f);
+                auto Command = &Context->DrawCommands[i].Rectangle;
+                auto Rectangle = Command->DrawRectangle;
+                u32 Color = PackColor(Command->Color);
                 
-                v = UiToCanvasPoint(Context, Rectangle->DrawRectangle.X + Rectangle->DrawRectangle.Width, Rectangle->DrawRectangle.Y);
-                glVertex3f(v.X, v.Y, -0.9f);
+                s32 X[] = { Rectangle.X, Rectangle.X + Rectangle.Width, Rectangle.X + Rectangle.Width, Rectangle.X };
+                s32 Y[] = { Rectangle.Y, Rectangle.Y, Rectangle.Y + Rectangle.Height, Rectangle.Y + Rectangle.Height };
                 
-                v = UiToCanvasPoint(Context, Rectangle->DrawRectangle.X + Rectangle->DrawRectangle.Width, Rectangle->DrawRectangle.Y + Rectangle->DrawRectangle.Height);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                v = UiToCanvasPoint(Context, Rectangle->DrawRectangle.X, Rectangle->DrawRectangle.Y + Rectangle->DrawRectangle.Height);
-                glVertex3f(v.X, v.Y, -0.9f);
-                
-                glEnd();
+                if (Command->IsFilled) {
+                    UiExtendRun(Context, GL_QUADS, 0, 4);
+                    
+                    for (u32 Corner = 0; Corner < 4; Corner++)
+                        UiPushVertex(Context, X[Corner], Y[Corner], vec2{}, Color);
+                }
+                else {
+                    // line loops can't be merged, so the outline is drawn as 4 lines
+                    UiExtendRun(Context, GL_LINES, 0, 8);
+                    
+                    for (u32 Corner = 0; Corner < 4; Corner++) {
+                        u32 Next = (Corner + 1) % 4;
+                        UiPushVertex(Context, X[Corner], Y[Corner], vec2{}, Color);
+                        UiPushVertex(Context, X[Next], Y[Next], vec2{}, Color);
+                    }
+                }
             } break;
             
             default:
@@ -206,7 +244,55 @@ UiRenderCommands(ui_context *Context)
         }
     }
     
-    Context->DrawCommands.Count = 0;
+    Context->Stats.CommandCount = Context->DrawCommands.Count;
+    Context->Stats.DrawCallCount = Context->Runs.Count;
+    Context->DrawCommands = {};
+    
+    if (Context->VertexCount == 0)
+        return;
+    
+    if (!Context->VertexBuffer)
+        glGenBuffers(1, &Context->VertexBuffer);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, Context->VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(sprite_vertex) * Context->VertexCount, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sprite_vertex) * Context->VertexCount, Context->Vertices);
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    
+    glVertexPointer(3, GL_FLOAT, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, X));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, U));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(sprite_vertex), (void *) offsetof(sprite_vertex, Color));
+    
+    glDisable(GL_DEPTH_TEST);
+    
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GEQUAL, 0.1f);
+    
+    for (u32 i = 0; i < Context->Runs.Count; i++)
+    {
+        auto Run = &Context->Runs[i];
+        
+        if (Run->Texture) {
+            glEnable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, Run->Texture);
+        }
+        else {
+            glDisable(GL_TEXTURE_2D);
+        }
+        
+        glDrawArrays(Run->Primitive, Run->FirstVertex, Run->VertexCount);
+    }
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 ui_text_cursor UiBeginText(ui_context *Context, font *Font, s32 X, s32 Y, bool DoRender = true, color Color = White_Color, f32 Scale = 1.0f) {
@@ -271,10 +357,16 @@ rect UiText(ui_text_cursor *Cursor, const char *Text, u32 TextCount) {
     return TextRect;
 }
 
+// the text is formatted into the Global_Frame_Arena, so there is no length limit
 rect UiWriteVA(ui_text_cursor *Cursor, const char *Format, va_list Parameters) {
-    char Buffer[2048];
+    va_list CountParameters;
+    va_copy(CountParameters, Parameters);
+    u32 ByteCount = vsnprintf(NULL, 0, Format, CountParameters);
+    va_end(CountParameters);
+    
+    char *Buffer = PUSH_ARRAY(&Global_Frame_Arena, char, ByteCount + 1);
+    vsnprintf(Buffer, ByteCount + 1, Format, Parameters);
     
-    u32 ByteCount = vsnprintf(ARRAY_WITH_COUNT(Buffer), Format, Parameters);
     return UiText(Cursor, Buffer, ByteCount);
 }
 